@@ -1,12 +1,41 @@
 #pragma once
 #include <string>
+#include <optional>
+#include <vector>
 
 struct Config {
     std::string input_file;
     std::string output_file;
     std::string velocity_file;
     double nmo_stretch_muting_percent;
+    std::string moveout_law = "hyperbolic";  // hyperbolic, eta или quartic
+    std::string eta_file;                    // Функции eta по CDP (SEG-Y или таблица) для законов eta и quartic
+    bool velocity_store = false;             // Функции скорости и eta из бинарного хранилища рядом с исходным файлом
+    std::string nmo_interpolation = "sinc";  // nearest, linear, cubic или sinc
+    int sinc_taps = 8;                       // Длина sinc-фильтра
+    int interpolation_table_resolution = 32; // Дробных сдвигов на отсчет в таблице коэффициентов
     int num_threads = 0; 
+    bool use_mmap = false; // io_backend=mmap: читать входной файл через отображение в память
+    int read_gap_tolerance = 8;   // Сколько лишних трасс можно прочитать ради объединения чтений
+    int prefetch_depth = 256;     // Сколько сейсмосборов читается заранее в фоновом потоке
+    int prefetch_memory_mb = 512; // Предел памяти заранее прочитанных сейсмосборов, МБ
+    int reorder_window = 512;     // Сколько обработанных CDP может ждать записи по порядку
+    bool stack_fold_header = true; // Записывать кратность суммы в поле NStackedTraces
+    int output_sample_format = 1; // Код DataSampleFormat выходного файла (1 - IBM, 5 - IEEE, ...)
+    bool binary_tracemap = false; // tracemap_backend=binary: карты трасс в бинарных файлах вместо SQLite
+    // mode=velocity_analysis: семблансные панели в output_file вместо суммирования
+    bool velocity_analysis = false;
+    float va_velocity_min = 1500.0f; // Пробные скорости, м/с
+    float va_velocity_max = 4500.0f;
+    float va_velocity_step = 50.0f;
+    float va_window_ms = 40.0f;      // Окно сембланса по времени, мс
+    int va_cdp_step = 1;             // Анализировать каждую N-ю CDP
+    std::vector<int> va_cdps;        // Или только эти CDP
+    // Ограничения обрабатываемых CDP и удалений (границы включены); без значения - без ограничения
+    std::optional<int> min_cdp;
+    std::optional<int> max_cdp;
+    std::optional<int> min_offset;
+    std::optional<int> max_offset;
 };
 
 Config load_config(const std::string& filename); 
\ No newline at end of file
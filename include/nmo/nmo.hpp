@@ -1,7 +1,11 @@
 #pragma once
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <span>
+#include <string>
 #include <algorithm>
+#include "sgylib/Gather.hpp"
 
 std::vector<std::vector<float>> nmo_correction(
     const std::vector<std::vector<float>>& cdp_gather,
@@ -9,4 +13,191 @@ std::vector<std::vector<float>> nmo_correction(
     const std::vector<float>& velocities,
     float dt,
     float stretch_mute_percent);
-    
+
+// То же для непрерывного сейсмосбора. Заголовки копируются в output,
+// память output переиспользуется.
+void nmo_correction(
+    const Gather& cdp_gather,
+    const std::vector<float>& offsets,
+    const std::vector<float>& velocities,
+    float dt,
+    float stretch_mute_percent,
+    Gather& output);
+
+/**
+ * @brief Способ интерполяции трассы в NMO-время.
+ * Nearest - ближайший отсчет; Linear - 2 точки; Cubic - кубическая свертка Кейса, 4 точки;
+ * Sinc - sinc с окном Кайзера на sinc_taps точек.
+ */
+enum class NmoInterpolation { Nearest, Linear, Cubic, Sinc };
+
+// Имя способа интерполяции ("nearest", "linear", "cubic", "sinc") -> значение; std::invalid_argument для неизвестного
+NmoInterpolation nmo_interpolation_from_name(const std::string& name);
+
+/**
+ * @brief Параметры интерполяции NMO.
+ *
+ * Коэффициенты фильтров (кроме Nearest) табулируются для table_resolution дробных сдвигов
+ * на отсчет; дробная часть NMO-времени округляется до ближайшего из них.
+ */
+struct NmoInterpolationOptions {
+    NmoInterpolation mode = NmoInterpolation::Sinc;
+    int sinc_taps = 8;          // Длина sinc-фильтра, четная, 2..64
+    int table_resolution = 32;  // Дробных сдвигов на отсчет, степень двойки 1..1024
+};
+
+/**
+ * @brief Закон кинематики (NMO-время по t0, скорости v, eta и удалению x).
+ * Hyperbolic - t^2 = t0^2 + x^2 / v^2; Eta - негиперболическая поправка Алхалифы - Цванкина
+ * -2 eta x^4 / (v^2 (t0^2 v^2 + (1 + 2 eta) x^2)); Quartic - ряд Тейлора 4-го порядка по x
+ * с A4 = -2 eta / (t0^2 v^4).
+ */
+enum class MoveoutLaw { Hyperbolic, Eta, Quartic };
+
+// Имя закона ("hyperbolic", "eta", "quartic") -> значение; std::invalid_argument для неизвестного
+MoveoutLaw moveout_law_from_name(const std::string& name);
+
+/**
+ * @class NmoEngine
+ * @brief NMO-поправка с предрасчитанными таблицами кинематики.
+ *
+ * set_velocity() один раз на CDP готовит величины, зависящие только от функций скоростей и eta.
+ * apply() строит таблицу на каждое различное удаление сейсмосбора (номера исходных
+ * отсчетов и границы мьютинга) и применяет ее ко всем трассам с этим удалением.
+ * Закон кинематики - параметр шаблона векторного цикла таблицы: у каждого закона
+ * свой цикл, выбор закона - один раз на таблицу. Для гиперболы начало зоны без мьютинга
+ * находится аналитически: растяжение превышает порог ровно там, где t * v(t) меньше
+ * порога, зависящего только от удаления; для остальных законов мьютинг проверяется
+ * векторно для каждого отсчета.
+ *
+ * Трасса интерполируется в дробное NMO-время табулированным фильтром (см. NmoInterpolationOptions)
+ * векторным ядром AVX2 / AVX-512. Окна, выходящие за край трассы, дополняются крайним отсчетом.
+ *
+ * Методы однопоточные: параллелизм - по сейсмосборам (см. run_gather_pipeline, nmo_stack_batch).
+ * Объект хранит буферы между вызовами; один объект на поток.
+ */
+class NmoEngine {
+public:
+    /**
+     * @throws std::invalid_argument при недопустимых sinc_taps или table_resolution.
+     */
+    explicit NmoEngine(const NmoInterpolationOptions& options = {}, MoveoutLaw law = MoveoutLaw::Hyperbolic);
+
+    /**
+     * @brief Задает функцию скоростей и параметры поправки.
+     * @param velocities Скорость на каждый отсчет времени, м/с.
+     * @param dt Шаг дискретизации, с.
+     * @param stretch_mute_percent Порог растяжения для мьютинга, %.
+     * @param eta Параметр eta на каждый отсчет для законов Eta и Quartic; пусто - нули.
+     * @throws std::invalid_argument если eta короче функции скоростей.
+     */
+    void set_velocity(std::span<const float> velocities, float dt, float stretch_mute_percent,
+                      std::span<const float> eta = {});
+
+    /**
+     * @brief NMO-поправка сейсмосбора. Заголовки копируются в output, память output переиспользуется.
+     * @throws std::invalid_argument если трассы длиннее функции скоростей или число удалений не совпадает с числом трасс.
+     */
+    void apply(const Gather& input, std::span<const float> offsets, Gather& output);
+
+    /**
+     * @brief NMO-поправка и суммирование за один проход, без исправленного сейсмосбора.
+     *
+     * Трассы по одной интерполируются в буфер и сразу прибавляются к сумме. Каждый отсчет
+     * суммы делится на свою кратность - число трасс, в которых он не замьючен и не выходит
+     * за конец трассы; отсчеты с нулевой кратностью равны нулю.
+     * @param stack Сумма, n_samples отсчетов.
+     * @param fold Кратность каждого отсчета.
+     * @return Число трасс, давших сумме хотя бы один отсчет.
+     * @throws std::invalid_argument как apply().
+     */
+    int apply_and_stack(const Gather& input, std::span<const float> offsets,
+                        std::vector<float>& stack, std::vector<int>& fold);
+
+    /**
+     * @brief Суммы по трассам после NMO-поправки, без нормировки (например, для мер когерентности).
+     * @param sum Сумма амплитуд на каждый отсчет.
+     * @param energy Сумма квадратов амплитуд; nullptr - не считать.
+     * @param fold Кратность каждого отсчета, как в apply_and_stack().
+     * @return Число трасс, давших сумме хотя бы один отсчет.
+     */
+    int accumulate(const Gather& input, std::span<const float> offsets,
+                   std::vector<float>& sum, std::vector<float>* energy, std::vector<int>& fold);
+
+private:
+    // Кинематика одного удаления
+    struct MoveoutTable {
+        int mute_end = 0;           // Отсчеты [0, mute_end) обнуляются мьютингом
+        int live_end = 0;           // С этого отсчета NMO-время выходит за трассу, дальше нули
+        std::vector<int32_t> base;  // Первый отсчет окна фильтра для выходного отсчета j
+        std::vector<int32_t> row;   // Смещение строки коэффициентов фильтра в coefs_
+        // Отсчеты, не обрабатываемые векторным ядром: окно у края трассы или мьютинг
+        // при немонотонной t * v(t) (строка -1, ноль)
+        std::vector<int32_t> special_out;
+        std::vector<int32_t> special_base;
+        std::vector<int32_t> special_row;
+    };
+    // Проверяет размеры и строит таблицы для всех удалений сейсмосбора
+    void build_tables(const Gather& input, std::span<const float> offsets);
+    void build_table(float offset, int n_samples, MoveoutTable& table);
+    void correct_trace(const float* trace, const MoveoutTable& table, int n_samples, float* out) const;
+
+    int taps_ = 1;             // Длина фильтра
+    int lead_ = 0;             // Сколько точек фильтра лежит до целой части NMO-времени
+    int resolution_ = 1;       // Дробных сдвигов на отсчет, степень двойки
+    int resolution_shift_ = 0; // log2(resolution_)
+    std::vector<float> coefs_; // resolution_ строк по taps_ коэффициентов
+
+    MoveoutLaw law_ = MoveoutLaw::Hyperbolic;
+    float dt_ = 0.0f;
+    float stretch_mute_percent_ = 0.0f;
+    std::vector<float> time_;      // t
+    std::vector<float> velocity2_; // v^2 (нулевая скорость заменяется на 1e-12)
+    std::vector<float> eta_;
+    std::vector<float> tv_;        // t * v, по ней ищется граница мьютинга гиперболы
+    bool tv_monotone_ = true;
+    std::vector<uint8_t> muted_;   // Поотсчетные признаки мьютинга строящейся таблицы
+
+    std::vector<float> unique_offsets_;
+    std::vector<int> trace_table_; // Номер таблицы для каждой трассы
+    std::vector<MoveoutTable> tables_;
+    std::vector<int> table_traces_; // Число трасс с каждой таблицей
+    std::vector<float> scratch_;    // Исправленная трасса при суммировании
+};
+
+/**
+ * @brief Одна CDP пакетной NMO-поправки с суммированием.
+ */
+struct NmoStackJob {
+    const Gather* gather = nullptr;
+    std::span<const float> offsets;    // Удаление каждой трассы
+    std::span<const float> velocities; // Функция скоростей CDP
+    std::span<const float> eta;        // Функция eta CDP; пусто - нули
+    // Результат NmoEngine::apply_and_stack; память переиспользуется между пакетами
+    std::vector<float> stack;
+    std::vector<int> fold;
+    int stacked_traces = 0;
+};
+
+/**
+ * @brief NMO-поправка и суммирование пакета CDP в одной параллельной области.
+ *
+ * Каждая CDP - отдельная задача OpenMP: освободившийся поток забирает следующую,
+ * поэтому CDP разной кратности не задерживают друг друга внутри пакета.
+ * @param engines Движки по одному на поток (например, omp_get_max_threads() копий прототипа);
+ *        хранятся у вызывающего между пакетами, чтобы буферы переиспользовались.
+ *        Потоков не больше engines.size().
+ * Первое исключение из задач пробрасывается после завершения пакета.
+ */
+void nmo_stack_batch(std::span<NmoStackJob> jobs, std::span<NmoEngine> engines, float dt, float stretch_mute_percent);
+
+/**
+ * @brief Имя используемого ядра интерполяции NMO: "avx512", "avx2" или "scalar".
+ */
+const char* nmo_kernel();
+
+/**
+ * @brief Принудительно выбирает ядро интерполяции NMO (для тестов и замеров).
+ * @return false, если ядро неизвестно или не поддерживается процессором.
+ */
+bool set_nmo_kernel(const std::string& name);
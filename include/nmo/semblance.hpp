@@ -0,0 +1,82 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "nmo/nmo.hpp"
+#include "sgylib/Gather.hpp"
+
+/**
+ * @brief Параметры семблансного анализа скоростей.
+ */
+struct SemblanceOptions {
+    // Пробные скорости, м/с: от velocity_min до velocity_max включительно с шагом velocity_step
+    float velocity_min = 1500.0f;
+    float velocity_max = 4500.0f;
+    float velocity_step = 50.0f;
+    int window = 11;                    // Скользящее окно по времени, отсчетов (четное увеличивается на 1)
+    float stretch_mute_percent = 30.0f; // Порог растяжения для мьютинга, %
+};
+
+/**
+ * @brief Пробные скорости панели.
+ * @throws std::invalid_argument при пустом диапазоне, неположительной скорости или шаге.
+ */
+std::vector<float> trial_velocities(const SemblanceOptions& options);
+
+/**
+ * @class SemblanceScanner
+ * @brief Сембланс сейсмосбора для одной пробной скорости.
+ *
+ * Сейсмосбор исправляется NmoEngine с постоянной скоростью; по трассам накапливаются сумма,
+ * сумма квадратов и кратность каждого отсчета (NmoEngine::accumulate). Сембланс
+ *     S(t0) = sum_w (sum_i a_i)^2 / sum_w (M * sum_i a_i^2),
+ * где M - кратность отсчета, считается скользящими суммами по окну w с центром в t0.
+ * Замьюченные отсчеты в суммы не входят.
+ *
+ * Однопоточный; объект хранит буферы между вызовами, один объект на поток.
+ */
+class SemblanceScanner {
+public:
+    /**
+     * @param engine Прототип NMO (способ интерполяции).
+     */
+    SemblanceScanner(const NmoEngine& engine, const SemblanceOptions& options, float dt);
+
+    /**
+     * @brief Сембланс для скорости velocity: gather.num_samples() значений от 0 до 1 в out.
+     * @throws std::invalid_argument как NmoEngine::apply().
+     */
+    void scan(const Gather& gather, std::span<const float> offsets, float velocity, float* out);
+
+private:
+    NmoEngine engine_;
+    int half_window_;
+    float dt_;
+    float stretch_mute_percent_;
+    std::vector<float> velocity_;
+    std::vector<float> sum_;
+    std::vector<float> energy_;
+    std::vector<int> fold_;
+};
+
+/**
+ * @brief Семблансная панель одной CDP.
+ */
+struct SemblanceJob {
+    const Gather* gather = nullptr;
+    std::span<const float> offsets; // Удаление каждой трассы
+    // Результат: трасса на каждую пробную скорость. Заголовки не заполняются;
+    // память переиспользуется между пакетами
+    Gather panel;
+};
+
+/**
+ * @brief Семблансные панели пакета CDP в одной параллельной области.
+ *
+ * Задача OpenMP - пара (CDP, пробная скорость), поэтому потоки загружены и при
+ * пакете из нескольких CDP.
+ * @param scanners По одному на поток, построенные с теми же options; хранятся
+ *        у вызывающего между пакетами. Потоков не больше scanners.size().
+ * Первое исключение из задач пробрасывается после завершения пакета.
+ */
+void semblance_batch(std::span<SemblanceJob> jobs, std::span<SemblanceScanner> scanners,
+                     const SemblanceOptions& options);
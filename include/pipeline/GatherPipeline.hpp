@@ -0,0 +1,161 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include "sgylib/GatherStream.hpp"
+
+/**
+ * @class ReorderBuffer
+ * @brief Восстанавливает исходный порядок результатов, вычисленных параллельно.
+ *
+ * Результаты приходят с номерами 0, 1, 2, ... в произвольном порядке, а выдаются
+ * строго по возрастанию номера. В буфере не больше window результатов: push()
+ * результата, опередившего выдачу на window и больше, ждет.
+ */
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(std::size_t window) : slots_(window > 0 ? window : 1) {}
+
+    /**
+     * @brief Кладет результат с номером ordinal, дождавшись места в окне.
+     * @return false, если буфер закрыт через close().
+     */
+    bool push(std::size_t ordinal, T&& value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [&] { return closed_ || ordinal < next_ + slots_.size(); });
+        if (closed_) return false;
+        Slot& slot = slots_[ordinal % slots_.size()];
+        slot.value = std::move(value);
+        slot.ready = true;
+        const bool is_next = ordinal == next_;
+        lock.unlock();
+        if (is_next) ready_cv_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Забирает следующий по порядку результат, дождавшись его.
+     * @return false, если после finish() все результаты выданы или буфер закрыт.
+     */
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Slot* slot = nullptr;
+        ready_cv_.wait(lock, [&] {
+            slot = &slots_[next_ % slots_.size()];
+            return closed_ || slot->ready || finished_;
+        });
+        if (closed_ || !slot->ready) return false;
+        out = std::move(slot->value);
+        slot->ready = false;
+        ++next_;
+        lock.unlock();
+        space_cv_.notify_all();
+        return true;
+    }
+
+    // Все результаты положены: pop() вернет false, когда выдаст оставшиеся
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+        }
+        ready_cv_.notify_all();
+    }
+
+    // Прерывает обмен: ждущие push() и pop() возвращают false
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_cv_.notify_all();
+        space_cv_.notify_all();
+    }
+
+private:
+    struct Slot {
+        T value{};
+        bool ready = false;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::condition_variable space_cv_;
+    std::vector<Slot> slots_;
+    std::size_t next_ = 0; // Номер следующего выдаваемого результата
+    bool finished_ = false;
+    bool closed_ = false;
+};
+
+/**
+ * @brief Параметры run_gather_pipeline.
+ */
+struct PipelineOptions {
+    int num_workers = 0;             // Рабочих потоков; 0 - по умолчанию OpenMP
+    std::size_t reorder_window = 512; // Сколько результатов может ждать записи
+};
+
+/**
+ * @brief Конвейер «чтение - обработка - запись» над потоком сейсмосборов.
+ *
+ * Чтение выполняет фоновый поток GatherStream. Рабочие потоки (команда OpenMP)
+ * забирают сейсмосборы по одному и обрабатывают их однопоточными ядрами (NmoEngine),
+ * поэтому сейсмосбор большой кратности занимает только свой поток: остальные берут
+ * следующие сейсмосборы, не дожидаясь его. Отдельный поток записи получает результаты
+ * через ReorderBuffer в исходном порядке сейсмосборов.
+ *
+ * @param make_worker Вызывается один раз в каждом рабочем потоке; возвращает функтор
+ *        void(const StreamedGather&, Result&) со своими буферами.
+ * @param sink void(Result&), вызывается из потока записи по порядку сейсмосборов.
+ * Первое исключение из любой стадии останавливает конвейер и пробрасывается наружу.
+ */
+template <typename Result, typename MakeWorker, typename Sink>
+void run_gather_pipeline(GatherStream& gathers, const PipelineOptions& options, MakeWorker&& make_worker, Sink&& sink) {
+    ReorderBuffer<Result> reorder(options.reorder_window);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+        }
+        reorder.close();
+    };
+
+    std::thread writer([&] {
+        try {
+            Result result{};
+            while (reorder.pop(result)) sink(result);
+        } catch (...) {
+            fail();
+        }
+    });
+
+    const int num_workers = options.num_workers > 0 ? options.num_workers : omp_get_max_threads();
+    #pragma omp parallel num_threads(num_workers)
+    {
+        try {
+            auto worker = make_worker();
+            while (auto item = gathers.next()) {
+                Result result{};
+                worker(static_cast<const StreamedGather&>(*item), result);
+                const std::size_t ordinal = item->ordinal;
+                gathers.recycle(std::move(item));
+                if (!reorder.push(ordinal, std::move(result))) break;
+            }
+        } catch (...) {
+            fail();
+        }
+    }
+
+    reorder.finish();
+    writer.join();
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <span>
+#include <stdexcept>
+#include <omp.h>
+
+/**
+ * @brief Выполняет fn(task, state) для каждой задачи из [0, n_tasks) в одной параллельной области.
+ *
+ * Задачи раздаются taskloop по одной: освободившийся поток забирает следующую, поэтому
+ * задачи разной длительности не простаивают друг за другом. state - состояние потока
+ * (движок, буферы) из per_thread по номеру потока: задачи без точек переключения внутри
+ * не мигрируют между потоками. per_thread хранится у вызывающего и переиспользуется
+ * между вызовами; потоков не больше per_thread.size().
+ * Первое исключение из задач пробрасывается после завершения всех задач.
+ * @throws std::invalid_argument если задачи есть, а per_thread пуст.
+ */
+template <typename State, typename Fn>
+void run_parallel_tasks(int n_tasks, std::span<State> per_thread, Fn&& fn) {
+    if (n_tasks <= 0) return;
+    if (per_thread.empty()) {
+        throw std::invalid_argument("run_parallel_tasks needs per-thread state");
+    }
+    const int team = std::min(static_cast<int>(per_thread.size()), n_tasks);
+    std::exception_ptr error;
+
+    #pragma omp parallel num_threads(team)
+    #pragma omp single
+    #pragma omp taskloop grainsize(1)
+    for (int task = 0; task < n_tasks; ++task) {
+        try {
+            fn(task, per_thread[omp_get_thread_num()]);
+        } catch (...) {
+            #pragma omp critical(run_parallel_tasks_error)
+            if (!error) error = std::current_exception();
+        }
+    }
+
+    if (error) std::rethrow_exception(error);
+}
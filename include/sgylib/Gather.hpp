@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Аллокатор с выравниванием по Alignment байт (для векторных загрузок).
+ */
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+};
+
+/**
+ * @class Gather
+ * @brief Сейсмосбор в непрерывной памяти: выровненный буфер отсчетов с шагом stride()
+ * и упакованный блок 240-байтовых заголовков.
+ *
+ * resize() не освобождает память, поэтому один объект можно переиспользовать
+ * для всех CDP без повторных выделений.
+ */
+class Gather {
+public:
+    static constexpr int HEADER_SIZE = 240;
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    Gather() = default;
+    Gather(int num_traces, int num_samples) { resize(num_traces, num_samples); }
+
+    /**
+     * @brief Задает размеры сейсмосбора. Содержимое после изменения размеров не определено.
+     */
+    void resize(int num_traces, int num_samples) {
+        constexpr std::size_t floats_per_line = ALIGNMENT / sizeof(float);
+        num_traces_ = num_traces;
+        num_samples_ = num_samples;
+        // Каждая трасса начинается с границы ALIGNMENT байт
+        stride_ = (static_cast<std::size_t>(num_samples) + floats_per_line - 1) / floats_per_line * floats_per_line;
+        if (samples_.size() < num_traces * stride_) samples_.resize(num_traces * stride_);
+        if (headers_.size() < static_cast<std::size_t>(num_traces) * HEADER_SIZE) {
+            headers_.resize(static_cast<std::size_t>(num_traces) * HEADER_SIZE);
+        }
+    }
+
+    void clear() { num_traces_ = 0; }
+
+    int num_traces() const { return num_traces_; }
+    int num_samples() const { return num_samples_; }
+    // Расстояние между началами соседних трасс, в отсчетах
+    std::size_t stride() const { return stride_; }
+    bool empty() const { return num_traces_ == 0; }
+
+    float* trace(int i) { return samples_.data() + i * stride_; }
+    const float* trace(int i) const { return samples_.data() + i * stride_; }
+
+    std::span<float> trace_span(int i) { return {trace(i), static_cast<std::size_t>(num_samples_)}; }
+    std::span<const float> trace_span(int i) const { return {trace(i), static_cast<std::size_t>(num_samples_)}; }
+
+    uint8_t* header(int i) { return headers_.data() + static_cast<std::size_t>(i) * HEADER_SIZE; }
+    const uint8_t* header(int i) const { return headers_.data() + static_cast<std::size_t>(i) * HEADER_SIZE; }
+
+private:
+    int num_traces_ = 0;
+    int num_samples_ = 0;
+    std::size_t stride_ = 0;
+    std::vector<float, AlignedAllocator<float, ALIGNMENT>> samples_;
+    std::vector<uint8_t> headers_;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Gather.hpp"
+
+class SegyReader;
+
+/**
+ * @brief Параметры упреждающего чтения GatherStream.
+ */
+struct GatherStreamOptions {
+    std::size_t prefetch_depth = 4;                 // Сколько прочитанных сейсмосборов может ждать в очереди
+    std::size_t memory_limit = std::size_t(512) << 20; // Предел памяти очереди, байт
+};
+
+/**
+ * @brief Сейсмосбор, выданный GatherStream.
+ */
+struct StreamedGather {
+    std::size_t ordinal = 0; // Номер сейсмосбора в потоке, с нуля
+    std::vector<int> key;    // Значения ключей группы (см. GatherSource)
+    Gather gather;
+};
+
+/**
+ * @brief Источник сейсмосборов: заполняет ключ и индексы трасс следующего сейсмосбора.
+ * @return false, когда сейсмосборы закончились.
+ */
+using GatherSource = std::function<bool(std::vector<int>& key, std::vector<int>& indices)>;
+
+/**
+ * @class GatherStream
+ * @brief Поток сейсмосборов с упреждающим чтением в фоновом потоке.
+ *
+ * Пока вызывающий код обрабатывает очередной сейсмосбор, фоновый поток читает
+ * следующие (не больше prefetch_depth и memory_limit байт в очереди; один сейсмосбор
+ * может превысить предел). Буферы сейсмосборов возвращаются через recycle() и
+ * переиспользуются, поэтому в установившемся режиме память не выделяется.
+ *
+ * Использование в range-for (буфер возвращается при переходе к следующему):
+ * @code
+ *   for (StreamedGather& g : reader.stream_gathers(map->open_cursor(1))) { ... }
+ * @endcode
+ * Или вручную, удерживая несколько сейсмосборов одновременно: next() / recycle().
+ * Сейсмосборы, удерживаемые вызывающим кодом, в пределы очереди не входят.
+ * next() и recycle() можно вызывать из нескольких потоков одновременно.
+ */
+class GatherStream {
+public:
+    GatherStream(const SegyReader& reader, GatherSource source, GatherStreamOptions options = {});
+    ~GatherStream();
+
+    GatherStream(const GatherStream&) = delete;
+    GatherStream& operator=(const GatherStream&) = delete;
+
+    /**
+     * @brief Следующий сейсмосбор в порядке источника; ждет, пока он будет прочитан.
+     * @return nullptr, когда поток исчерпан. Ошибка чтения пробрасывается отсюда.
+     */
+    std::unique_ptr<StreamedGather> next();
+
+    // Возвращает буфер сейсмосбора для повторного использования
+    void recycle(std::unique_ptr<StreamedGather> item);
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = StreamedGather;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(GatherStream* stream) : stream_(stream), current_(stream->next()) {}
+
+        StreamedGather& operator*() const { return *current_; }
+        StreamedGather* operator->() const { return current_.get(); }
+        iterator& operator++() {
+            stream_->recycle(std::move(current_));
+            current_ = stream_->next();
+            return *this;
+        }
+        bool operator==(std::default_sentinel_t) const { return !current_; }
+
+    private:
+        GatherStream* stream_ = nullptr;
+        std::unique_ptr<StreamedGather> current_;
+    };
+
+    iterator begin() { return iterator(this); }
+    std::default_sentinel_t end() { return {}; }
+
+private:
+    void run();
+    static std::size_t gather_bytes(const StreamedGather& item);
+
+    const SegyReader& reader_;
+    GatherSource source_;
+    GatherStreamOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_cv_; // Появился сейсмосбор или поток завершился
+    std::condition_variable space_cv_; // Освободилось место в очереди
+    std::deque<std::unique_ptr<StreamedGather>> ready_;
+    std::vector<std::unique_ptr<StreamedGather>> free_;
+    std::size_t ready_bytes_ = 0;
+    bool finished_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    std::thread worker_;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Формат списков индексов трасс в BLOB карты трасс.
+ *
+ * Формат хранится в PRAGMA user_version базы: карты, построенные до появления
+ * сжатия, имеют версию 0 и читаются как сырые int32.
+ */
+enum class IndexEncoding : int {
+    Raw = 0,        // int32 в порядке байтов машины
+    DeltaVarint = 1 // Разности соседних индексов, varint, с сериями постоянного шага
+};
+
+/**
+ * @brief Кодирует список индексов в DeltaVarint и дописывает в конец out.
+ *
+ * Формат: varint число индексов, затем сегменты. Сегмент начинается с varint (len << 1 | is_run):
+ *   - серия (is_run = 1): одна zigzag-varint разность, повторенная len раз
+ *     (монотонные списки с постоянным шагом занимают несколько байт);
+ *   - литералы (is_run = 0): len zigzag-varint разностей.
+ * Первая разность отсчитывается от нуля.
+ */
+void encode_indices(std::span<const int> indices, std::vector<char>& out);
+
+/**
+ * @brief Декодирует BLOB в формате encoding и дописывает индексы в конец out.
+ * @param max_count Наибольшее допустимое число индексов (например, число трасс карты);
+ *                  проверяется до выделения памяти под результат.
+ * @throws std::runtime_error если данные повреждены или индексов больше max_count.
+ */
+void decode_indices(IndexEncoding encoding, const void* data, size_t size, uint64_t max_count, std::vector<int>& out);
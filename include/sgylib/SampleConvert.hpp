@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Пакетная конвертация отсчетов трасс IBM <-> IEEE.
+// Реализация выбирается один раз во время выполнения по возможностям процессора
+// (AVX-512, AVX2, SSE4.1 или скалярная) и дает результат, побитно совпадающий
+// со скалярными ibm_to_float / ieee_to_ibm из SegyUtil.hpp.
+
+/**
+ * @brief Конвертирует n отсчетов IBM float (big-endian) в IEEE float.
+ * @param src Указатель на 4 * n байт в формате файла.
+ * @param dst Буфер на n элементов.
+ */
+void ibm_to_float_block(const uint8_t* src, float* dst, size_t n);
+
+/**
+ * @brief Конвертирует n отсчетов IEEE float в IBM float (big-endian).
+ * Бесконечности и NaN кодируются максимальным по модулю числом IBM.
+ * @param src Указатель на n элементов.
+ * @param dst Буфер на 4 * n байт.
+ */
+void float_to_ibm_block(const float* src, uint8_t* dst, size_t n);
+
+/**
+ * @brief Имя используемой реализации: "avx512", "avx2", "sse4.1" или "scalar".
+ */
+const char* sample_convert_kernel();
+
+/**
+ * @brief Принудительно выбирает реализацию (для тестов и замеров).
+ * @param name Одно из имен, возвращаемых sample_convert_kernel().
+ * @return false, если реализация неизвестна или не поддерживается процессором.
+ */
+bool set_sample_convert_kernel(const std::string& name);
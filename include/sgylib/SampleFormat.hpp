@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "SampleConvert.hpp"
+
+/**
+ * @brief Формат отсчетов трассы (поле DataSampleFormat бинарного заголовка).
+ */
+enum class SampleFormat : int {
+    IBM = 1,   // 4-байтовое IBM float
+    Int32 = 2, // 4-байтовое целое со знаком
+    Int16 = 3, // 2-байтовое целое со знаком
+    IEEE = 5,  // 4-байтовое IEEE float
+    Int8 = 8   // 1-байтовое целое со знаком
+};
+
+// Сигнатуры функций пакетного декодирования/кодирования n отсчетов
+using SampleDecoder = void (*)(const uint8_t* src, float* dst, size_t n);
+using SampleEncoder = void (*)(const float* src, uint8_t* dst, size_t n);
+
+namespace sample_detail {
+
+inline uint16_t load_be16(const uint8_t* p) {
+    uint16_t v;
+    std::memcpy(&v, p, 2);
+    return __builtin_bswap16(v);
+}
+
+inline uint32_t load_be32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return __builtin_bswap32(v);
+}
+
+inline void store_be16(uint8_t* p, uint16_t v) {
+    v = __builtin_bswap16(v);
+    std::memcpy(p, &v, 2);
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    v = __builtin_bswap32(v);
+    std::memcpy(p, &v, 4);
+}
+
+// Округление к ближайшему целому с насыщением до диапазона [lo, hi]
+inline int32_t saturate(float v, float lo, float hi) {
+    return static_cast<int32_t>(std::nearbyint(std::clamp(v, lo, hi)));
+}
+
+} // namespace sample_detail
+
+/**
+ * @brief Кодек отсчетов, специализированный для каждого формата на этапе компиляции.
+ * size - размер одного отсчета в байтах; decode/encode работают с big-endian данными.
+ */
+template <SampleFormat F>
+struct SampleCodec;
+
+template <>
+struct SampleCodec<SampleFormat::IBM> {
+    static constexpr int size = 4;
+    static void decode(const uint8_t* src, float* dst, size_t n) { ibm_to_float_block(src, dst, n); }
+    static void encode(const float* src, uint8_t* dst, size_t n) { float_to_ibm_block(src, dst, n); }
+};
+
+template <>
+struct SampleCodec<SampleFormat::IEEE> {
+    static constexpr int size = 4;
+    // Только перестановка байтов: компилятор векторизует цикл
+    static void decode(const uint8_t* src, float* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t bits = sample_detail::load_be32(src + i * 4);
+            std::memcpy(&dst[i], &bits, 4);
+        }
+    }
+    static void encode(const float* src, uint8_t* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t bits;
+            std::memcpy(&bits, &src[i], 4);
+            sample_detail::store_be32(dst + i * 4, bits);
+        }
+    }
+};
+
+template <>
+struct SampleCodec<SampleFormat::Int32> {
+    static constexpr int size = 4;
+    static void decode(const uint8_t* src, float* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = static_cast<float>(static_cast<int32_t>(sample_detail::load_be32(src + i * 4)));
+        }
+    }
+    static void encode(const float* src, uint8_t* dst, size_t n) {
+        // 2147483520 - наибольшее float, не превышающее INT32_MAX
+        for (size_t i = 0; i < n; ++i) {
+            int32_t v = sample_detail::saturate(src[i], -2147483648.0f, 2147483520.0f);
+            sample_detail::store_be32(dst + i * 4, static_cast<uint32_t>(v));
+        }
+    }
+};
+
+template <>
+struct SampleCodec<SampleFormat::Int16> {
+    static constexpr int size = 2;
+    static void decode(const uint8_t* src, float* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = static_cast<float>(static_cast<int16_t>(sample_detail::load_be16(src + i * 2)));
+        }
+    }
+    static void encode(const float* src, uint8_t* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            int32_t v = sample_detail::saturate(src[i], -32768.0f, 32767.0f);
+            sample_detail::store_be16(dst + i * 2, static_cast<uint16_t>(v));
+        }
+    }
+};
+
+template <>
+struct SampleCodec<SampleFormat::Int8> {
+    static constexpr int size = 1;
+    static void decode(const uint8_t* src, float* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = static_cast<float>(static_cast<int8_t>(src[i]));
+        }
+    }
+    static void encode(const float* src, uint8_t* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = static_cast<uint8_t>(sample_detail::saturate(src[i], -128.0f, 127.0f));
+        }
+    }
+};
+
+/**
+ * @brief Преобразует код DataSampleFormat в SampleFormat.
+ * Код 0 встречается в старых файлах и трактуется как IBM.
+ * @throws std::runtime_error для неподдерживаемых форматов.
+ */
+inline SampleFormat sample_format_from_code(int code) {
+    switch (code) {
+        case 0:
+        case 1: return SampleFormat::IBM;
+        case 2: return SampleFormat::Int32;
+        case 3: return SampleFormat::Int16;
+        case 5: return SampleFormat::IEEE;
+        case 8: return SampleFormat::Int8;
+        default:
+            throw std::runtime_error("Unsupported DataSampleFormat: " + std::to_string(code));
+    }
+}
+
+inline int sample_size(SampleFormat fmt) {
+    switch (fmt) {
+        case SampleFormat::IBM:   return SampleCodec<SampleFormat::IBM>::size;
+        case SampleFormat::Int32: return SampleCodec<SampleFormat::Int32>::size;
+        case SampleFormat::Int16: return SampleCodec<SampleFormat::Int16>::size;
+        case SampleFormat::IEEE:  return SampleCodec<SampleFormat::IEEE>::size;
+        case SampleFormat::Int8:  return SampleCodec<SampleFormat::Int8>::size;
+    }
+    throw std::invalid_argument("Unknown sample format");
+}
+
+inline SampleDecoder get_sample_decoder(SampleFormat fmt) {
+    switch (fmt) {
+        case SampleFormat::IBM:   return &SampleCodec<SampleFormat::IBM>::decode;
+        case SampleFormat::Int32: return &SampleCodec<SampleFormat::Int32>::decode;
+        case SampleFormat::Int16: return &SampleCodec<SampleFormat::Int16>::decode;
+        case SampleFormat::IEEE:  return &SampleCodec<SampleFormat::IEEE>::decode;
+        case SampleFormat::Int8:  return &SampleCodec<SampleFormat::Int8>::decode;
+    }
+    throw std::invalid_argument("Unknown sample format");
+}
+
+inline SampleEncoder get_sample_encoder(SampleFormat fmt) {
+    switch (fmt) {
+        case SampleFormat::IBM:   return &SampleCodec<SampleFormat::IBM>::encode;
+        case SampleFormat::Int32: return &SampleCodec<SampleFormat::Int32>::encode;
+        case SampleFormat::Int16: return &SampleCodec<SampleFormat::Int16>::encode;
+        case SampleFormat::IEEE:  return &SampleCodec<SampleFormat::IEEE>::encode;
+        case SampleFormat::Int8:  return &SampleCodec<SampleFormat::Int8>::encode;
+    }
+    throw std::invalid_argument("Unknown sample format");
+}
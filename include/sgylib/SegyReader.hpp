@@ -4,10 +4,45 @@
 #include <vector>
 #include <memory> // Для std::shared_ptr
 #include <cstdint>
-#include <fstream>
 #include <unordered_map>
 #include <optional>
 #include "TraceMap.hpp" // Включаем новый заголовок TraceMap
+#include "SampleFormat.hpp"
+#include "Gather.hpp"
+#include "SourceFingerprint.hpp"
+#include "GatherStream.hpp"
+
+/**
+ * @brief Способ доступа к данным файла.
+ * Pread - позиционное чтение (pread) без общей позиции в файле.
+ * Mmap  - файл целиком отображается в память, чтение без системных вызовов.
+ * Оба способа допускают одновременные вызовы const-методов из разных потоков.
+ */
+enum class IoBackend { Pread, Mmap };
+
+/**
+ * @brief Подсказки ядру о характере доступа к файлу (madvise / posix_fadvise).
+ */
+enum class AccessPattern { Normal, Sequential, Random, WillNeed };
+
+/**
+ * @brief Легковесное представление трассы, указывающее прямо в отображенный файл.
+ * Действительно, пока жив SegyReader. Отсчеты хранятся в исходном виде (big-endian).
+ */
+struct TraceView {
+    const uint8_t* header;  // 240 байт заголовка трассы
+    const uint8_t* samples; // num_samples * sample_size байт отсчетов
+};
+
+/**
+ * @brief Описание одной карты трасс для SegyReader::build_tracemaps.
+ */
+struct TraceMapSpec {
+    std::string name;              // Внутреннее имя карты
+    std::string db_path;           // Путь к файлу карты
+    std::vector<std::string> keys; // Ключи заголовка (например, {"FieldRecord"})
+    TraceMapBackend backend = TraceMapBackend::SQLite;
+};
 
 class SegyReader {
 public:
@@ -15,8 +50,10 @@ public:
      * @brief Основной конструктор. Открывает SEG-Y файл для чтения.
      * @param filename Путь к SEG-Y файлу.
      * @param mode Режим открытия ("r" - чтение, "r+" - чтение/запись).
+     * @param backend Способ доступа к файлу (pread или отображение в память).
      */
-    explicit SegyReader(const std::string& filename, const std::string& mode = "r");
+    explicit SegyReader(const std::string& filename, const std::string& mode = "r",
+                        IoBackend backend = IoBackend::Pread);
     ~SegyReader();
 
     // Запрещаем копирование и присваивание, т.к. класс управляет файловым ресурсом.
@@ -32,8 +69,10 @@ public:
      * @param map_name Внутреннее имя для этой карты (например, "cdp_gather").
      * @param db_path Путь к файлу SQLite, где будет храниться карта.
      * @param keys Ключи заголовка для построения карты (например, {"cdp", "offset"}).
+     * @param backend Формат хранения: база SQLite или отображаемый в память бинарный индекс.
      */
-    void build_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys);
+    void build_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys,
+                        TraceMapBackend backend = TraceMapBackend::SQLite);
 
     /**
      * @brief Загружает ранее созданную TraceMap из файла БД.
@@ -42,8 +81,26 @@ public:
      * @param map_name Внутреннее имя для этой карты.
      * @param db_path Путь к файлу SQLite.
      * @param keys Ключи, с которыми была создана эта карта (должны совпадать).
+     * @param backend Формат, в котором карта была построена.
+     */
+    void load_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys,
+                       TraceMapBackend backend = TraceMapBackend::SQLite);
+
+    /**
+     * @brief Строит несколько карт за одно чтение заголовков файла.
+     * Каждая дополнительная карта стоит разбора заголовков в памяти, а не повторного
+     * чтения файла. Существующие файлы карт перезаписываются.
+     * @param specs Имена, пути, ключи и форматы карт.
      */
-    void load_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys);
+    void build_tracemaps(const std::vector<TraceMapSpec>& specs);
+
+    /**
+     * @brief Открывает карту и приводит ее в соответствие с файлом (см. TraceMap::update_map):
+     * новую карту строит, к существующей добавляет дописанные трассы, при перезаписи файла перестраивает.
+     * @return Что пришлось сделать с картой.
+     */
+    TraceMapUpdate update_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys,
+                                   TraceMapBackend backend = TraceMapBackend::SQLite);
 
         /**
      * @brief Читает сырой блок данных из файла.
@@ -53,6 +110,24 @@ public:
      */
     void read_raw_block(int start_trace_idx, size_t bytes_to_read, char* buffer) const;
 
+    /**
+     * @brief Читает только заголовки трасс [start_trace, start_trace + count) подряд в buffer.
+     * Для длинных трасс (см. header_scan_is_strided) отсчеты не читаются вовсе:
+     * заголовки забираются параллельными позиционными чтениями или касанием
+     * нужных страниц отображения. Для коротких трасс файл читается блоками.
+     * @param buffer Буфер на count * 240 байт.
+     */
+    void read_headers(int start_trace, int count, uint8_t* buffer) const;
+
+    // true, если трассы настолько длинные, что read_headers пропускает отсчеты
+    bool header_scan_is_strided() const { return trace_bsize_ >= HEADER_SCAN_MIN_TRACE_BYTES; }
+
+    /**
+     * @brief Отпечаток файла для проверки актуальности карт трасс.
+     * @param indexed_traces Число первых трасс, покрытых картой; по ним считается контрольная сумма.
+     */
+    SourceFingerprint fingerprint(int indexed_traces) const;
+
     // --- ОСНОВНЫЕ МЕТОДЫ ДОСТУПА К ДАННЫМ ---
 
     std::vector<float> get_trace(int index) const;
@@ -69,11 +144,86 @@ public:
                                 std::vector<std::vector<uint8_t>>& headers,
                                 std::vector<std::vector<float>>& traces) const;
 
+    /**
+     * @brief Читает сейсмосбор (заголовки и отсчеты) в непрерывный контейнер.
+     * Память gather переиспользуется, если ее достаточно.
+     */
+    void read_gather(const std::string& tracemap_name,
+                     const std::vector<std::optional<int>>& keys,
+                     Gather& gather) const;
+
+    /**
+     * @brief Читает сейсмосбор по готовому списку индексов трасс
+     * (например, из TraceMap::find_trace_indices_bulk). Трассы идут по возрастанию индекса.
+     */
+    void read_gather(std::vector<int> indices, Gather& gather) const;
+
+    /**
+     * @brief Поток сейсмосборов по курсору карты с упреждающим чтением в фоновом потоке
+     * (см. GatherStream). Ключ каждого сейсмосбора - ключ группы курсора.
+     * Ридер и карта курсора должны пережить поток.
+     */
+    GatherStream stream_gathers(std::unique_ptr<TraceMapCursor> cursor, GatherStreamOptions options = {}) const;
+
+    /**
+     * @brief Поток сейсмосборов для заданной последовательности значений ключей карты tracemap_name.
+     * Ключ каждого сейсмосбора - заданные (не std::nullopt) значения ключей; сейсмосбор
+     * без трасс выдается пустым.
+     */
+    GatherStream stream_gathers(const std::string& tracemap_name,
+                                std::vector<std::vector<std::optional<int>>> key_sequence,
+                                GatherStreamOptions options = {}) const;
+
+    // --- ДОСТУП БЕЗ КОПИРОВАНИЯ (только для IoBackend::Mmap) ---
+
+    /**
+     * @brief Возвращает представление трассы внутри отображенного файла.
+     * @throws std::logic_error если файл не отображен в память.
+     */
+    TraceView get_trace_view(int index) const;
+
+    /**
+     * @brief Возвращает представления всех трасс сейсмосбора, отсортированные по индексу.
+     */
+    std::vector<TraceView> get_gather_views(const std::string& tracemap_name,
+                                            const std::vector<std::optional<int>>& keys) const;
+
+    /**
+     * @brief Декодирует отсчеты трассы из представления в float.
+     * @param view Представление трассы.
+     * @param out Буфер на num_samples() элементов.
+     */
+    void decode_trace(const TraceView& view, float* out) const;
+
+    /**
+     * @brief Сообщает ядру ожидаемый характер доступа ко всему файлу.
+     */
+    void advise(AccessPattern pattern) const;
+
+    /**
+     * @brief То же, что advise(), но для диапазона трасс [start_trace, start_trace + count).
+     */
+    void advise_traces(int start_trace, int count, AccessPattern pattern) const;
+
+    bool is_mapped() const { return map_ != nullptr; }
+
+    /**
+     * @brief Задает, сколько лишних трасс допускается прочитать между двумя нужными,
+     * чтобы объединить их в одно чтение. 0 - объединять только соседние трассы.
+     * Не потокобезопасно: вызывать до начала параллельного чтения.
+     */
+    void set_read_gap_tolerance(int traces);
+    int read_gap_tolerance() const { return read_gap_tolerance_; }
+
     // --- ГЕТТЕРЫ И ВСПОМОГАТЕЛЬНЫЕ МЕТОДЫ ---
 
     int num_traces() const;
     int num_samples() const;
     float sample_interval() const;
+    // Формат отсчетов из поля DataSampleFormat бинарного заголовка
+    SampleFormat sample_format() const { return sample_format_; }
+    // Размер трассы в файле: 240 байт заголовка + отсчеты
+    int trace_size() const { return trace_bsize_; }
 
     int32_t get_header_value_i32(int trace_index, const std::string& key) const;
     int32_t get_header_value_i32(const std::vector<uint8_t>& trace_header, const std::string& key) const;
@@ -96,13 +246,26 @@ public:
 private:
     std::string filename_;
     std::string mode_;
-    mutable std::fstream file_;
+    IoBackend backend_;
+    int fd_ = -1;                  // Дескриптор файла, читается только через pread
+    const uint8_t* map_ = nullptr; // Отображение файла (IoBackend::Mmap)
+    size_t map_size_ = 0;
     std::vector<char> text_header_;
     std::vector<uint8_t> bin_header_;
     int num_traces_ = 0;
     int num_samples_ = 0;
     float sample_interval_ = 0.0f;
     int trace_bsize_ = 0;
+    SampleFormat sample_format_ = SampleFormat::IBM;
+    SampleDecoder decode_ = nullptr; // Выбирается один раз по sample_format_
+    int read_gap_tolerance_ = 8;
+
+    // Верхняя граница одного объединенного чтения в read_gather_block
+    static constexpr size_t MAX_COALESCED_READ_BYTES = 64 * 1024 * 1024;
+    // Начиная с этого размера трассы read_headers читает заголовки по отдельности
+    static constexpr int HEADER_SCAN_MIN_TRACE_BYTES = 16 * 1024;
+    // Размер блока read_headers для коротких трасс
+    static constexpr size_t HEADER_SCAN_BLOCK_BYTES = 16 * 1024 * 1024;
 
     // ИЗМЕНЕНО: Храним умные указатели на TraceMap, а не сами объекты.
     std::unordered_map<std::string, std::shared_ptr<TraceMap>> tracemaps_;
@@ -112,7 +275,15 @@ private:
     inline std::streamoff trace_offset(int index) const { return data_offset() + static_cast<std::streamoff>(index) * trace_bsize_; }
     inline std::streamoff trace_data_offset(int index) const { return trace_offset(index) + 240; }
 
+    // Читает bytes байт по смещению offset независимо от выбранного способа доступа
+    void read_at(std::streamoff offset, size_t bytes, char* buffer) const;
+    void map_file(size_t file_size);
+
     void read_gather_block(const std::vector<int>& indices,
                            std::vector<std::vector<uint8_t>>& headers,
                            std::vector<std::vector<float>>& traces) const;
+
+    // Вызывает fn(i, указатель на трассу indices[i]), объединяя чтения соседних трасс
+    template <typename Fn>
+    void for_each_trace(const std::vector<int>& indices, Fn&& fn) const;
 };
\ No newline at end of file
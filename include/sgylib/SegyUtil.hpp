@@ -20,6 +20,12 @@ inline int32_t get_i32_be(const uint8_t* buf, int offset1based) {
            buf[offset + 3];
 }
 
+// Читает 2- или 4-байтовое поле со знаком (2-байтовые поля расширяются знаком)
+inline int32_t read_header_field(const uint8_t* buf, const FieldInfo& info) {
+    return info.size == 2 ? static_cast<int32_t>(get_i16_be(buf, info.offset))
+                          : get_i32_be(buf, info.offset);
+}
+
 inline float ibm_to_float(uint32_t ibm) {
     if (ibm == 0) return 0.0f;
     int sign = ((ibm >> 31) & 0x01);
@@ -67,4 +73,13 @@ inline void put_u32_be(uint8_t* buf, uint32_t value) {
     buf[1] = static_cast<uint8_t>((value >> 16) & 0xFF);
     buf[2] = static_cast<uint8_t>((value >> 8)  & 0xFF);
     buf[3] = static_cast<uint8_t>(value & 0xFF);
-}
\ No newline at end of file
+}
+
+// Записывает 2- или 4-байтовое поле со знаком (для 2-байтовых полей значение усекается)
+inline void write_header_field(uint8_t* buf, const FieldInfo& info, int32_t value) {
+    if (info.size == 2) {
+        set_i16_be(buf, info.offset, static_cast<int16_t>(value));
+    } else {
+        set_i32_be(buf, info.offset, value);
+    }
+}
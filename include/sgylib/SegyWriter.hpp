@@ -5,18 +5,23 @@
 #include <cstdint>
 #include <fstream>
 #include "SegyReader.hpp"
+#include "SampleFormat.hpp"
+#include "Gather.hpp"
 
 class SegyWriter {
 public:
     // Конструктор, создающий Writer на основе существующего Reader.
-    explicit SegyWriter(const std::string& filename, const SegyReader& reader);
+    // format - формат отсчетов выходного файла (по умолчанию IBM).
+    explicit SegyWriter(const std::string& filename, const SegyReader& reader,
+                        SampleFormat format = SampleFormat::IBM);
     
     // Конструктор, создающий Writer с явно заданными параметрами.
     SegyWriter(const std::string& filename,
                const std::vector<char>& text_header,
                const std::vector<uint8_t>& bin_header,
                int num_samples,
-               float sample_interval);
+               float sample_interval,
+               SampleFormat format = SampleFormat::IBM);
     
     ~SegyWriter();
 
@@ -27,8 +32,14 @@ public:
     // Записывает одну трассу (заголовок + отсчеты).
     void write_trace(const std::vector<uint8_t>& header, const std::vector<float>& samples);
 
+    // То же без проверок размера: 240 байт заголовка и num_samples отсчетов.
+    void write_trace(const uint8_t* header, const float* samples);
+
     // Записывает целый сейсмосбор (несколько заголовков и трасс).
     void write_gather(const std::vector<std::vector<uint8_t>>& headers, const std::vector<std::vector<float>>& traces);
+
+    // Записывает непрерывный сейсмосбор одним системным вызовом.
+    void write_gather(const Gather& gather);
     
     // Псевдоним для обратной совместимости, если нужен.
     void write_gather_block(const std::vector<std::vector<uint8_t>>& headers, const std::vector<std::vector<float>>& traces);
@@ -36,6 +47,8 @@ public:
     // Текущее количество записанных трасс.
     int num_traces() const { return num_traces_; }
 
+    SampleFormat sample_format() const { return sample_format_; }
+
 private:
     std::string filename_;
     std::ofstream file_;
@@ -45,6 +58,9 @@ private:
     int num_samples_ = 0;
     float sample_interval_ = 0.0f;
     int trace_bsize_ = 0;
+    SampleFormat sample_format_ = SampleFormat::IBM;
+    SampleEncoder encode_ = nullptr; // Выбирается один раз по sample_format_
+    std::vector<uint8_t> buffer_;    // Переиспользуемый буфер кодирования
 
     // --- ИСПРАВЛЕНИЕ: ДОБАВЛЕНЫ ОБЪЯВЛЕНИЯ ПРИВАТНЫХ МЕТОДОВ ---
     
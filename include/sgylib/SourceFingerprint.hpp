@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Отпечаток SEG-Y файла, по которому построена карта трасс.
+ *
+ * По нему карта определяет, актуальна ли она: файл не менялся, к нему дописали
+ * трассы (достаточно просканировать хвост) или его перезаписали (нужна полная перестройка).
+ * Контрольная сумма покрывает текстовый заголовок и заголовки первой и последней
+ * проиндексированных трасс. Бинарный заголовок в нее не входит: при дописывании
+ * трасс в нем обновляются счетчики.
+ */
+struct SourceFingerprint {
+    uint64_t file_size = 0;
+    int64_t mtime_ns = 0;
+    int64_t num_traces = 0;
+    int64_t trace_size = 0;       // Размер трассы с заголовком, байт
+    uint64_t header_checksum = 0; // FNV-1a
+
+    bool operator==(const SourceFingerprint&) const = default;
+};
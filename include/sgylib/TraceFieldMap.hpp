@@ -3,10 +3,18 @@
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <stdexcept>
 #include "SegyUtil.hpp"
 
-inline const std::unordered_map<std::string, FieldInfo> TraceFieldOffsets = {
+struct TraceFieldEntry {
+    std::string_view name;
+    FieldInfo info;
+};
+
+// Таблица полей заголовка трассы, доступная на этапе компиляции
+inline constexpr TraceFieldEntry TraceFieldTable[] = {
     {"TRACE_SEQUENCE_LINE", {1, 4}},
     {"TRACE_SEQUENCE_FILE", {5, 4}},
     {"FieldRecord", {9, 4}},
@@ -101,6 +109,27 @@ inline const std::unordered_map<std::string, FieldInfo> TraceFieldOffsets = {
     {"UnassignedInt2", {237, 2}}
 };
 
+// Поиск по имени во время выполнения
+inline const std::unordered_map<std::string, FieldInfo> TraceFieldOffsets = [] {
+    std::unordered_map<std::string, FieldInfo> offsets;
+    for (const auto& entry : TraceFieldTable) {
+        offsets.emplace(entry.name, entry.info);
+    }
+    return offsets;
+}();
+
+/**
+ * @brief Находит поле заголовка трассы по имени на этапе компиляции:
+ *   constexpr FieldInfo OFFSET = trace_field("offset");
+ * Неизвестное имя в constexpr-контексте приводит к ошибке компиляции.
+ */
+constexpr FieldInfo trace_field(std::string_view name) {
+    for (const auto& entry : TraceFieldTable) {
+        if (entry.name == name) return entry.info;
+    }
+    throw std::invalid_argument("Unknown trace header field");
+}
+
 // Универсальная функция для чтения любого поля из trace header по имени
 inline int32_t get_trace_field_value(const uint8_t* buf, const std::string& field_name) {
     auto it = TraceFieldOffsets.find(field_name);
@@ -108,12 +137,49 @@ inline int32_t get_trace_field_value(const uint8_t* buf, const std::string& fiel
         throw std::invalid_argument("Unknown trace header field: " + field_name);
     }
     const FieldInfo& info = it->second;
-    if (info.size == 2) {
-        return static_cast<int32_t>(get_i16_be(buf, info.offset)); // sign-extend
-    } else if (info.size == 4) {
-        return get_i32_be(buf, info.offset);
-    } else {
+    if (info.size != 2 && info.size != 4) {
         throw std::runtime_error("Unsupported field size for trace header: " + std::to_string(info.size));
     }
+    return read_header_field(buf, info);
 }
 
+/**
+ * @class HeaderKeySet
+ * @brief Набор полей заголовка, разрешенный по именам один раз.
+ * extract() читает все поля по фиксированным смещениям без хеширования и выделений памяти,
+ * поэтому подходит для горячих циклов по трассам.
+ */
+class HeaderKeySet {
+public:
+    /**
+     * @param names Имена полей заголовка трассы.
+     * @throws std::invalid_argument если имя поля неизвестно.
+     */
+    explicit HeaderKeySet(const std::vector<std::string>& names) {
+        fields_.reserve(names.size());
+        for (const auto& name : names) {
+            auto it = TraceFieldOffsets.find(name);
+            if (it == TraceFieldOffsets.end()) {
+                throw std::invalid_argument("Unknown trace header field: " + name);
+            }
+            if (it->second.size != 2 && it->second.size != 4) {
+                throw std::runtime_error("Unsupported field size for trace header: " + std::to_string(it->second.size));
+            }
+            fields_.push_back(it->second);
+        }
+    }
+
+    size_t size() const { return fields_.size(); }
+    const FieldInfo& field(size_t i) const { return fields_[i]; }
+
+    // Записывает size() значений полей заголовка header в out
+    void extract(const uint8_t* header, int32_t* out) const {
+        for (size_t i = 0; i < fields_.size(); ++i) {
+            out[i] = read_header_field(header, fields_[i]);
+        }
+    }
+
+private:
+    std::vector<FieldInfo> fields_;
+};
+
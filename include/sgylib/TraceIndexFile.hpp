@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "SourceFingerprint.hpp"
+
+/**
+ * @class TraceIndexFile
+ * @brief Компактный бинарный индекс трасс, отображаемый в память.
+ *
+ * Формат файла (порядок байтов - родной для машины):
+ *   - заголовок IndexHeader (магическое число, версия, размеры, смещения секций,
+ *     начиная с версии 2 - отпечаток исходного SEG-Y файла);
+ *   - имена ключей, разделенные '\0';
+ *   - кортежи ключей int32[num_tuples * num_keys], отсортированные лексикографически;
+ *   - смещения CSR uint64[num_tuples + 1];
+ *   - индексы трасс int32[num_indices], внутри кортежа по возрастанию.
+ *
+ * Открытие файла сводится к mmap, поиск - к двоичному поиску по кортежам.
+ * Трассы кортежей с общим префиксом ключей лежат подряд, поэтому запрос,
+ * задающий первые ключи, отдается как span без копирования.
+ */
+class TraceIndexFile {
+public:
+    /**
+     * @brief Открывает и отображает в память существующий индекс.
+     * @param path Путь к файлу индекса.
+     * @param keys Ожидаемые ключи; должны совпадать с сохраненными в файле.
+     */
+    TraceIndexFile(const std::string& path, const std::vector<std::string>& keys);
+    ~TraceIndexFile();
+
+    TraceIndexFile(const TraceIndexFile&) = delete;
+    TraceIndexFile& operator=(const TraceIndexFile&) = delete;
+
+    /**
+     * @brief Записывает индекс на диск.
+     * @param tuples Отсортированные кортежи, num_keys значений на кортеж.
+     * @param offsets Смещения CSR (tuples.size() / num_keys + 1 элементов).
+     * @param indices Индексы трасс всех кортежей подряд.
+     * @param fingerprint Отпечаток SEG-Y файла, по которому построен индекс.
+     */
+    static void write(const std::string& path,
+                      const std::vector<std::string>& keys,
+                      const std::vector<int32_t>& tuples,
+                      const std::vector<uint64_t>& offsets,
+                      const std::vector<int32_t>& indices,
+                      const SourceFingerprint& fingerprint);
+
+    /**
+     * @brief Индексы трасс, если заданные ключи образуют префикс (остальные - std::nullopt).
+     * @return std::nullopt, если после пропущенного ключа задан следующий.
+     */
+    std::optional<std::span<const int32_t>> find_prefix(const std::vector<std::optional<int>>& key_values) const;
+
+    // Индексы трасс для произвольного набора заданных ключей
+    std::vector<int> find(const std::vector<std::optional<int>>& key_values) const;
+
+    /**
+     * @brief Индексы трасс для всех значений ключа key_idx из [first, last], по возрастанию значения.
+     * Для первого ключа - двоичный поиск и проход по непрерывному участку, для остальных - полный проход.
+     */
+    std::vector<std::pair<int, std::vector<int>>> find_range(size_t key_idx, int first, int last) const;
+
+    // Отсортированные уникальные значения ключа с номером key_idx
+    std::vector<int> unique_values(size_t key_idx) const;
+
+    // Номер первого кортежа, у которого первый ключ не меньше first_key
+    uint64_t lower_bound(int32_t first_key) const { return prefix_range(&first_key, 1).first; }
+
+    uint64_t num_tuples() const { return num_tuples_; }
+    uint64_t num_indices() const { return num_indices_; }
+
+    // Значения ключей и индексы трасс кортежа с номером i (0 <= i < num_tuples())
+    std::span<const int32_t> tuple_keys(uint64_t i) const { return {tuple(i), num_keys_}; }
+    std::span<const int32_t> tuple_indices(uint64_t i) const {
+        return {indices_ + offsets_[i], static_cast<size_t>(offsets_[i + 1] - offsets_[i])};
+    }
+
+    // Отпечаток исходного файла; std::nullopt для индексов версии 1
+    const std::optional<SourceFingerprint>& fingerprint() const { return fingerprint_; }
+
+private:
+    // Диапазон кортежей [first, last), совпадающих по первым prefix_len ключам
+    std::pair<uint64_t, uint64_t> prefix_range(const int32_t* prefix, size_t prefix_len) const;
+    const int32_t* tuple(uint64_t i) const { return tuples_ + i * num_keys_; }
+
+    std::string path_;
+    const uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    uint32_t num_keys_ = 0;
+    uint64_t num_tuples_ = 0;
+    uint64_t num_indices_ = 0;
+    const int32_t* tuples_ = nullptr;
+    const uint64_t* offsets_ = nullptr;
+    const int32_t* indices_ = nullptr;
+    std::optional<SourceFingerprint> fingerprint_;
+};
@@ -4,10 +4,88 @@
 #include <vector>
 #include <optional>
 #include <memory>
+#include <span>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include "SourceFingerprint.hpp"
+#include "IndexCodec.hpp"
 
 // Прямое объявление, чтобы не включать заголовок sqlite3 в hpp-файл
 struct sqlite3;
+struct sqlite3_stmt;
 class SegyReader;
+class TraceIndexFile;
+class TraceMap;
+
+/**
+ * @brief Способ хранения карты трасс на диске.
+ */
+enum class TraceMapBackend {
+    SQLite, // База SQLite, индексы кортежа хранятся в BLOB
+    Binary  // Отображаемый в память файл TraceIndexFile (отсортированные кортежи + CSR)
+};
+
+/**
+ * @brief Результат TraceMap::update_map.
+ */
+enum class TraceMapUpdate {
+    UpToDate, // Карта соответствует файлу
+    Appended, // В карту добавлены дописанные в конец файла трассы
+    Rebuilt   // Карты не было или файл перезаписан: карта построена заново
+};
+
+/**
+ * @brief Диапазон значений ключа [first, last], обе границы включены.
+ */
+struct KeyRange {
+    int first;
+    int last;
+};
+
+/**
+ * @class TraceMapCursor
+ * @brief Последовательный обход карты трасс по возрастанию ключей с группировкой
+ * по первым ключам. Открывается через TraceMap::open_cursor.
+ *
+ * Для SQLite это один запрос с ORDER BY по ключам, для бинарного индекса - проход
+ * по отсортированным кортежам. Курсор не потокобезопасен; карта должна его пережить.
+ */
+class TraceMapCursor {
+public:
+    ~TraceMapCursor();
+
+    TraceMapCursor(const TraceMapCursor&) = delete;
+    TraceMapCursor& operator=(const TraceMapCursor&) = delete;
+
+    /**
+     * @brief Переходит к следующей группе.
+     * @param group_key Значения ключей группы (первые group_keys ключей карты).
+     * @param indices Индексы трасс группы; прежнее содержимое заменяется.
+     * @return false, если групп больше нет.
+     */
+    bool next(std::vector<int>& group_key, std::vector<int>& indices);
+
+private:
+    friend class TraceMap;
+    TraceMapCursor(const TraceMap& map, size_t group_keys, std::vector<std::optional<KeyRange>> ranges);
+
+    // Кортеж удовлетворяет всем заданным диапазонам
+    bool matches(const int32_t* tuple) const;
+
+    const TraceMap& map_;
+    size_t group_keys_;
+    std::vector<std::optional<KeyRange>> ranges_;
+
+    // SQLite: запрос курсора; строка, прочитанная, но еще не отданная в группу
+    sqlite3_stmt* stmt_ = nullptr;
+    bool row_pending_ = false;
+    bool done_ = false;
+    // Бинарный индекс: текущий кортеж
+    uint64_t tuple_ = 0;
+};
 
 /**
  * @class TraceMap
@@ -23,8 +101,10 @@ public:
      * @brief Конструктор.
      * @param db_path Путь к файлу базы данных SQLite. Если файл не существует, он будет создан.
      * @param keys Список имен полей заголовка трассы (например, "cdp", "offset"), которые будут использоваться в качестве ключей для индексации.
+     * @param backend Формат хранения. Для Binary db_path - путь к файлу индекса; существующий файл открывается сразу.
      */
-    TraceMap(const std::string& db_path, const std::vector<std::string>& keys);
+    TraceMap(const std::string& db_path, const std::vector<std::string>& keys,
+             TraceMapBackend backend = TraceMapBackend::SQLite);
     ~TraceMap();
 
     // Запрещаем копирование, так как управляем ресурсом (БД)
@@ -38,6 +118,25 @@ public:
      */
     void build_map(const SegyReader& reader);
 
+    /**
+     * @brief Строит несколько карт по одному чтению заголовков (например, CDP, пункты
+     * взрыва и приема). Каждая карта перезаписывается, как в build_map.
+     * @param reader Экземпляр SegyReader для доступа к файлу.
+     * @param maps Карты с разными наборами ключей.
+     */
+    static void build_maps(const SegyReader& reader, const std::vector<TraceMap*>& maps);
+
+    /**
+     * @brief Приводит карту в соответствие с файлом по сохраненному отпечатку (SourceFingerprint).
+     * Если к файлу только дописывали трассы, сканируются лишь новые трассы и их индексы
+     * добавляются к существующим кортежам. Полная перестройка - только если отпечатка нет
+     * или он показывает, что файл перезаписан.
+     */
+    TraceMapUpdate update_map(const SegyReader& reader);
+
+    // Отпечаток файла, по которому построена карта; std::nullopt, если карта не построена
+    std::optional<SourceFingerprint> stored_fingerprint() const;
+
     /**
      * @brief Находит индексы трасс, соответствующих заданным значениям ключей.
      * @param key_values Вектор значений для поиска. Порядок должен соответствовать ключам, заданным в конструкторе.
@@ -46,6 +145,29 @@ public:
      */
     std::vector<int> find_trace_indices(const std::vector<std::optional<int>>& key_values) const;
 
+    /**
+     * @brief Индексы трасс без копирования: span указывает прямо в отображенный файл индекса.
+     * Доступно только для TraceMapBackend::Binary и запросов, задающих первые ключи подряд
+     * (без 'sequence_number'). Span действителен, пока жива карта.
+     */
+    std::span<const int> find_trace_span(const std::vector<std::optional<int>>& key_values) const;
+
+    /**
+     * @brief Индексы трасс для списка значений одного ключа.
+     * Плотные значения (например, блок CDP) читаются одним упорядоченным проходом, при котором
+     * декодируются только запрошенные; разреженные - точечными запросами из кеша.
+     * @param key Имя ключа.
+     * @param values Значения ключа в любом порядке.
+     * @return result[i] - индексы трасс для values[i] (пустой вектор, если значения нет в карте).
+     */
+    std::vector<std::vector<int>> find_trace_indices_bulk(const std::string& key, const std::vector<int>& values) const;
+
+    /**
+     * @brief Все значения ключа из диапазона [first, last] вместе с индексами их трасс.
+     * @return Пары (значение, индексы трасс) по возрастанию значения.
+     */
+    std::vector<std::pair<int, std::vector<int>>> find_trace_indices_range(const std::string& key, int first, int last) const;
+
     /**
      * @brief Получает все уникальные значения для указанного ключа из карты.
      * @param key Имя ключа (должно быть одним из ключей, переданных в конструктор).
@@ -53,21 +175,83 @@ public:
      */
     std::vector<int> get_unique_values(const std::string& key) const;
 
+    /**
+     * @brief Индексы трасс, у которых каждый ключ попадает в свой диапазон.
+     * @param ranges Диапазоны по порядку ключей; std::nullopt или отсутствующий элемент - любое значение.
+     *               Без единого диапазона возвращаются все трассы.
+     */
+    std::vector<int> find_trace_indices_where(const std::vector<std::optional<KeyRange>>& ranges) const;
+
+    /**
+     * @brief Открывает курсор, выдающий группы трасс по возрастанию ключей.
+     * @param group_keys Сколько первых ключей образуют группу (1 для {"CDP", "offset"} -
+     *                   сейсмосборы CDP; 0 - все подходящие трассы одной группой).
+     * @param ranges Фильтры по ключам, как в find_trace_indices_where.
+     */
+    std::unique_ptr<TraceMapCursor> open_cursor(size_t group_keys,
+                                                const std::vector<std::optional<KeyRange>>& ranges = {}) const;
+
     const std::string& db_path() const { return db_path_; }
     const std::vector<std::string>& keys() const { return keys_; }
+    TraceMapBackend backend() const { return backend_; }
 
 private:
+    friend class TraceMapCursor;
+
     void open_db();
     void create_table();
     void check_db_error(int error_code, const char* context) const;
     int find_key_index(const std::string& key) const;
 
-    // Хелперы для сериализации/десериализации вектора индексов в/из BLOB
-    static std::vector<char> serialize_indices(const std::vector<int>& indices);
-    static std::vector<int> deserialize_indices(const char* data, int size);
+    // Подготовленный запрос из кеша; компилируется при первом обращении. Вызывать под stmt_mutex_.
+    sqlite3_stmt* cached_statement(std::unordered_map<uint64_t, sqlite3_stmt*>& cache, uint64_t shape,
+                                   const std::function<std::string()>& make_sql) const;
+
+    // Значения ключа key_idx из [first, last] с индексами трасс по возрастанию значения;
+    // с only (отсортированные значения) остальные пропускаются без декодирования BLOB
+    std::vector<std::pair<int, std::vector<int>>> scan_key_range(int key_idx, int first, int last,
+                                                                 const std::vector<int>* only) const;
+
+    // Кодирует индексы в BLOB в формате blob_encoding_ (декодирование - decode_indices)
+    void serialize_indices(std::span<const int> indices, std::vector<char>& blob) const;
+
+    // Кортежи ключей и индексы их трасс в формате CSR; кортежи отсортированы,
+    // индексы трасс кортежа - indices[offsets[g], offsets[g + 1]) по возрастанию
+    struct KeyEntries {
+        std::vector<int32_t> tuples;       // keys_.size() значений на кортеж
+        std::vector<uint64_t> offsets{0};
+        std::vector<int32_t> indices;
+        size_t size() const { return offsets.size() - 1; }
+    };
+
+    // Сканирует заголовки трасс [start_trace, end_trace) и группирует индексы по кортежам ключей
+    // для каждой из карт maps за одно чтение заголовков
+    static std::vector<KeyEntries> scan_traces(const SegyReader& reader, const std::vector<const TraceMap*>& maps,
+                                               int start_trace, int end_trace);
+    // Сортирует записи ключей (n_keys значений на трассу, начиная с first_trace) и группирует их в CSR
+    static KeyEntries group_records(const std::vector<int32_t>& keys, size_t n_keys, int first_trace);
+    // Сохраняет кортежи и отпечаток; при append индексы добавляются к уже сохраненным
+    void write_entries(const KeyEntries& entries, const SourceFingerprint& fingerprint, bool append);
+
+    // Выбирает трассу с номером seq_num внутри результата, если он запрошен
+    static std::vector<int> select_sequence_number(std::vector<int> combined_indices, std::optional<int> seq_num);
+    // Записывает собранную карту в файл индекса и открывает его
+    void write_index_file(const KeyEntries& entries, const SourceFingerprint& fingerprint);
 
     std::string db_path_;
     std::vector<std::string> keys_;
+    TraceMapBackend backend_;
     sqlite3* db_ = nullptr;
+    IndexEncoding blob_encoding_ = IndexEncoding::DeltaVarint; // Формат BLOB в базе (PRAGMA user_version)
+    // Больше индексов, чем трасс в файле, в BLOB быть не может; без отпечатка (старые карты) - без ограничения
+    uint64_t max_blob_indices_ = std::numeric_limits<int>::max();
+    std::unique_ptr<TraceIndexFile> index_;
     bool has_seq_number_ = false; // Флаг для специальной обработки 'sequence_number'
+
+    // Подготовленные SELECT: по маске заданных ключей и по номеру ключа для диапазонных запросов.
+    // Подготовленный запрос нельзя выполнять из двух потоков одновременно, поэтому
+    // все обращения к кешам и выполнение запросов идут под stmt_mutex_.
+    mutable std::mutex stmt_mutex_;
+    mutable std::unordered_map<uint64_t, sqlite3_stmt*> find_stmts_;
+    mutable std::unordered_map<uint64_t, sqlite3_stmt*> range_stmts_;
 };
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+#include <vector>
+#include "sgylib/Gather.hpp"
+
+// Суммирование трасс сейсмосбора с нормировкой на число трасс
+std::vector<float> stack_traces(const std::vector<std::vector<float>>& traces);
+
+// То же для непрерывного сейсмосбора: трассы обходятся построчно
+std::vector<float> stack_traces(const Gather& gather);
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Контрольные функции: CDP -> точки (время, с; значение) по возрастанию времени
+using ControlFunctions = std::map<int, std::vector<std::pair<float, float>>>;
+
+/**
+ * @class VelocityField
+ * @brief Поле скоростей (или другого параметра, например eta) на регулярной сетке времени.
+ *
+ * Задается контрольными CDP. Функция CDP между двумя контрольными - линейная смесь их
+ * функций с весами по расстоянию в номерах CDP; за крайними контрольными CDP берется
+ * функция крайней. Контрольная функция переводится на отсчеты t = i * dt одним
+ * проходом слиянием: линейная интерполяция между точками, за крайними точками -
+ * значение крайней.
+ *
+ * Функции CDP строятся по запросу и хранятся в небольшом LRU-кэше, контрольные функции
+ * загружаются через loader тоже по запросу, поэтому память не растет с длиной профиля.
+ * at() можно вызывать из нескольких потоков.
+ */
+class VelocityField {
+public:
+    // Точки контрольной функции CDP (в любом порядке по времени)
+    using ControlLoader = std::function<std::vector<std::pair<float, float>>(int cdp)>;
+
+    /**
+     * @param control_cdps Номера контрольных CDP.
+     * @param loader Загружает точки контрольной CDP; вызывается под внутренней блокировкой.
+     * @param cache_size Сколько функций CDP (и столько же контрольных) хранит кэш.
+     * @throws std::invalid_argument без контрольных CDP или при num_samples < 1.
+     */
+    VelocityField(std::vector<int> control_cdps, ControlLoader loader, int num_samples, float dt,
+                  std::size_t cache_size = 16);
+
+    /**
+     * @brief Поле по готовым контрольным функциям (например, из текстовой таблицы).
+     */
+    VelocityField(ControlFunctions controls, int num_samples, float dt, std::size_t cache_size = 16);
+
+    /**
+     * @brief Функция CDP, num_samples значений. Указатель остается действительным
+     * после вытеснения из кэша.
+     * @throws std::runtime_error если контрольная функция пуста.
+     */
+    std::shared_ptr<const std::vector<float>> at(int cdp);
+
+    int num_samples() const { return num_samples_; }
+
+private:
+    using Function = std::shared_ptr<const std::vector<float>>;
+
+    // LRU-кэш функций по номеру CDP
+    class Cache {
+    public:
+        explicit Cache(std::size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+        Function find(int cdp);
+        void insert(int cdp, Function function);
+
+    private:
+        std::size_t capacity_;
+        std::list<std::pair<int, Function>> entries_; // Недавние - в начале
+        std::unordered_map<int, std::list<std::pair<int, Function>>::iterator> index_;
+    };
+
+    // Таблица живет в loader; ключи берутся до того, как она туда попадет
+    VelocityField(std::shared_ptr<const ControlFunctions> controls, int num_samples, float dt, std::size_t cache_size);
+
+    Function control(int cdp);
+    Function resample(std::vector<std::pair<float, float>> points) const;
+
+    std::vector<int> control_cdps_; // По возрастанию
+    ControlLoader loader_;
+    int num_samples_;
+    float dt_;
+    std::mutex mutex_;
+    Cache functions_;
+    Cache controls_;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "sgylib/SourceFingerprint.hpp"
+#include "velocity/VelocityField.hpp"
+
+/**
+ * @class VelocityStore
+ * @brief Бинарное хранилище функций скорости (или eta) по CDP, отображаемое в память.
+ *
+ * Формат файла (порядок байтов - родной для машины):
+ *   - заголовок StoreHeader (магическое число, версия, число отсчетов, шаг, число CDP,
+ *     смещения секций, отпечаток исходного файла скоростей);
+ *   - номера CDP int32[num_cdps] по возрастанию;
+ *   - значения float[num_cdps * num_samples], функция CDP - подряд.
+ *
+ * Строится один раз по VelocityField (из SEG-Y или таблицы) и переиспользуется, пока
+ * не изменились исходный файл и сетка времени. Функция CDP отдается как span прямо
+ * в отображение: без копирования и блокировок, страницы подгружаются при обращении.
+ */
+class VelocityStore {
+public:
+    /**
+     * @brief Открывает и отображает в память существующее хранилище.
+     * @throws std::runtime_error если файл не открывается, поврежден или другой версии.
+     */
+    explicit VelocityStore(const std::string& path);
+    ~VelocityStore();
+
+    VelocityStore(const VelocityStore&) = delete;
+    VelocityStore& operator=(const VelocityStore&) = delete;
+
+    /**
+     * @brief Записывает функции поля для CDP cdps на диск.
+     * @param source Отпечаток файла, по которому построено поле (source_fingerprint()).
+     */
+    static void build(const std::string& path, VelocityField& field, std::vector<int> cdps, float dt,
+                      const SourceFingerprint& source);
+
+    // Отпечаток файла скоростей: размер и время изменения
+    static SourceFingerprint source_fingerprint(const std::string& path);
+
+    // Построено ли хранилище по этому файлу и на этой сетке времени
+    bool matches(const SourceFingerprint& source, int num_samples, float dt) const;
+
+    // Функция CDP, num_samples() значений; пустой span, если CDP нет в хранилище
+    std::span<const float> at(int cdp) const;
+
+    std::span<const int32_t> cdps() const { return {cdps_, static_cast<size_t>(num_cdps_)}; }
+    int num_samples() const { return num_samples_; }
+    float dt() const { return dt_; }
+
+private:
+    std::string path_;
+    const uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    int num_samples_ = 0;
+    float dt_ = 0.0f;
+    uint64_t num_cdps_ = 0;
+    const int32_t* cdps_ = nullptr;
+    const float* values_ = nullptr;
+    SourceFingerprint source_;
+};
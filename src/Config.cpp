@@ -51,12 +51,24 @@ namespace {
     
         Config cfg; // Создаем конфиг со значениями по умолчанию
     
+        if (params.count("mode")) {
+            const std::string& mode = params.at("mode");
+            if (mode == "velocity_analysis") {
+                cfg.velocity_analysis = true;
+            } else if (mode != "stack") {
+                throw std::runtime_error("Invalid mode in config file (expected 'stack' or 'velocity_analysis'): " + mode);
+            }
+        }
+
         try {
             // --- ОБЯЗАТЕЛЬНЫЕ ПАРАМЕТРЫ ---
             // Используем .at() который выбросит исключение, если ключ не найден
             cfg.input_file = params.at("input_file");
             cfg.output_file = params.at("output_file");
-            cfg.velocity_file = params.at("velocity_file");
+            // Анализ скоростей строит их сам
+            if (!cfg.velocity_analysis) {
+                cfg.velocity_file = params.at("velocity_file");
+            }
     
         } catch (const std::out_of_range& oor) {
             // Перехватываем исключение и выдаем понятное сообщение
@@ -69,9 +81,144 @@ namespace {
         if (params.count("nmo_stretch_muting_percent")) {
             cfg.nmo_stretch_muting_percent = std::stof(params.at("nmo_stretch_muting_percent"));
         }
+        if (params.count("nmo_interpolation")) {
+            const std::string& mode = params.at("nmo_interpolation");
+            if (mode != "nearest" && mode != "linear" && mode != "cubic" && mode != "sinc") {
+                throw std::runtime_error("Invalid nmo_interpolation in config file (expected 'nearest', 'linear', 'cubic' or 'sinc'): " + mode);
+            }
+            cfg.nmo_interpolation = mode;
+        }
+        if (params.count("moveout_law")) {
+            const std::string& law = params.at("moveout_law");
+            if (law != "hyperbolic" && law != "eta" && law != "quartic") {
+                throw std::runtime_error("Invalid moveout_law in config file (expected 'hyperbolic', 'eta' or 'quartic'): " + law);
+            }
+            cfg.moveout_law = law;
+        }
+        if (params.count("eta_file")) {
+            cfg.eta_file = params.at("eta_file");
+        }
+        if (!cfg.velocity_analysis && cfg.moveout_law != "hyperbolic" && cfg.eta_file.empty()) {
+            throw std::runtime_error("moveout_law=" + cfg.moveout_law + " requires eta_file in config file");
+        }
+        if (params.count("sinc_taps")) {
+            cfg.sinc_taps = std::stoi(params.at("sinc_taps"));
+        }
+        if (params.count("interpolation_table_resolution")) {
+            cfg.interpolation_table_resolution = std::stoi(params.at("interpolation_table_resolution"));
+        }
         if (params.count("num_threads")) {
             cfg.num_threads = std::stoi(params.at("num_threads"));
         }
+        if (params.count("read_gap_tolerance")) {
+            cfg.read_gap_tolerance = std::stoi(params.at("read_gap_tolerance"));
+        }
+        if (params.count("prefetch_depth")) {
+            cfg.prefetch_depth = std::stoi(params.at("prefetch_depth"));
+            if (cfg.prefetch_depth < 1) {
+                throw std::runtime_error("prefetch_depth must be positive: " + params.at("prefetch_depth"));
+            }
+        }
+        if (params.count("prefetch_memory_mb")) {
+            cfg.prefetch_memory_mb = std::stoi(params.at("prefetch_memory_mb"));
+            if (cfg.prefetch_memory_mb < 1) {
+                throw std::runtime_error("prefetch_memory_mb must be positive: " + params.at("prefetch_memory_mb"));
+            }
+        }
+        if (params.count("reorder_window")) {
+            cfg.reorder_window = std::stoi(params.at("reorder_window"));
+            if (cfg.reorder_window < 1) {
+                throw std::runtime_error("reorder_window must be positive: " + params.at("reorder_window"));
+            }
+        }
+        if (params.count("io_backend")) {
+            const std::string& backend = params.at("io_backend");
+            if (backend == "mmap") {
+                cfg.use_mmap = true;
+            } else if (backend != "pread" && backend != "stream") {
+                throw std::runtime_error("Invalid io_backend in config file (expected 'pread' or 'mmap'): " + backend);
+            }
+        }
+        if (params.count("min_cdp")) {
+            cfg.min_cdp = std::stoi(params.at("min_cdp"));
+        }
+        if (params.count("max_cdp")) {
+            cfg.max_cdp = std::stoi(params.at("max_cdp"));
+        }
+        if (params.count("min_offset")) {
+            cfg.min_offset = std::stoi(params.at("min_offset"));
+        }
+        if (params.count("max_offset")) {
+            cfg.max_offset = std::stoi(params.at("max_offset"));
+        }
+        if (params.count("tracemap_backend")) {
+            const std::string& backend = params.at("tracemap_backend");
+            if (backend == "binary") {
+                cfg.binary_tracemap = true;
+            } else if (backend != "sqlite") {
+                throw std::runtime_error("Invalid tracemap_backend in config file (expected 'sqlite' or 'binary'): " + backend);
+            }
+        }
+        if (params.count("stack_fold_header")) {
+            const std::string& value = params.at("stack_fold_header");
+            if (value == "true") {
+                cfg.stack_fold_header = true;
+            } else if (value == "false") {
+                cfg.stack_fold_header = false;
+            } else {
+                throw std::runtime_error("Invalid stack_fold_header in config file (expected 'true' or 'false'): " + value);
+            }
+        }
+        if (params.count("velocity_store")) {
+            const std::string& value = params.at("velocity_store");
+            if (value == "true") {
+                cfg.velocity_store = true;
+            } else if (value == "false") {
+                cfg.velocity_store = false;
+            } else {
+                throw std::runtime_error("Invalid velocity_store in config file (expected 'true' or 'false'): " + value);
+            }
+        }
+        if (params.count("va_velocity_min")) {
+            cfg.va_velocity_min = std::stof(params.at("va_velocity_min"));
+        }
+        if (params.count("va_velocity_max")) {
+            cfg.va_velocity_max = std::stof(params.at("va_velocity_max"));
+        }
+        if (params.count("va_velocity_step")) {
+            cfg.va_velocity_step = std::stof(params.at("va_velocity_step"));
+        }
+        if (params.count("va_window_ms")) {
+            cfg.va_window_ms = std::stof(params.at("va_window_ms"));
+            if (!(cfg.va_window_ms >= 0.0f)) {
+                throw std::runtime_error("va_window_ms must not be negative: " + params.at("va_window_ms"));
+            }
+        }
+        if (params.count("va_cdp_step")) {
+            cfg.va_cdp_step = std::stoi(params.at("va_cdp_step"));
+            if (cfg.va_cdp_step < 1) {
+                throw std::runtime_error("va_cdp_step must be positive: " + params.at("va_cdp_step"));
+            }
+        }
+        if (params.count("va_cdps")) {
+            // Список через запятую
+            std::istringstream list(params.at("va_cdps"));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!trim(item).empty()) cfg.va_cdps.push_back(std::stoi(item));
+            }
+        }
+        if (params.count("output_sample_format")) {
+            // Имена форматов и соответствующие коды DataSampleFormat
+            static const std::unordered_map<std::string, int> formats = {
+                {"ibm", 1}, {"int32", 2}, {"int16", 3}, {"ieee", 5}, {"int8", 8}
+            };
+            auto it = formats.find(params.at("output_sample_format"));
+            if (it == formats.end()) {
+                throw std::runtime_error("Invalid output_sample_format in config file: " + params.at("output_sample_format"));
+            }
+            cfg.output_sample_format = it->second;
+        }
     
         return cfg;
     }
\ No newline at end of file
@@ -2,9 +2,14 @@
 #include "sgylib/SegyWriter.hpp"
 #include "sgylib/TraceMap.hpp"
 #include "nmo/nmo.hpp"
+#include "nmo/semblance.hpp"
+#include "pipeline/GatherPipeline.hpp"
+#include "velocity/VelocityField.hpp"
+#include "velocity/VelocityStore.hpp"
 #include "Config.hpp"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <cmath>
@@ -12,16 +17,15 @@
 #include <string>
 #include <omp.h>
 #include "sgylib/SegyUtil.hpp"
+#include "sgylib/TraceFieldMap.hpp"
 #include <chrono>
 #include "util.hpp"
 #include <filesystem>
-
-// ------------------------ Типы ----------------------------
-using VelTable = std::map<int, std::vector<std::pair<float, float>>>;
+#include <limits>
 
 // -------------------- Считывание таблицы ------------------
-VelTable read_velocity_table(const std::string& path) {
-    VelTable table;
+ControlFunctions read_velocity_table(const std::string& path) {
+    ControlFunctions table;
     std::ifstream file(path);
     if (!file) throw std::runtime_error("Cannot open velocity table: " + path);
 
@@ -51,72 +55,184 @@ VelTable read_velocity_table(const std::string& path) {
 }
 
 
-// --------- Интерполяция скоростей на временной оси -------
-std::map<int, std::vector<float>> interpolate_velocity_cube(
-    const VelTable& table,
-    const std::vector<int>& cdps,
-    int n, float dt)
-{
-    std::map<int, std::vector<float>> result;
-
-    for (int cdp : cdps) {
-        // Поиск ближайших CDP
-        auto it = table.lower_bound(cdp);
-        VelTable::const_iterator use;
-        if (it == table.end()) {
-            use = std::prev(it);
-        } else if (it == table.begin()) {
-            use = it;
-        } else {
-            auto prev_it = std::prev(it);
-            use = (cdp - prev_it->first < it->first - cdp) ? prev_it : it;
+// ------- Функции времени по CDP (скорости, eta) -----------
+// Из SEG-Y (трасса на контрольную CDP) или из таблицы "CDP TIME VALUE". Поле строит
+// функции CDP по запросу: трассы SEG-Y читаются только для нужных контрольных CDP
+std::unique_ptr<VelocityField> open_velocity_field(const std::string& path, const std::string& what, int num_samples,
+                                                   float dt, TraceMapBackend map_backend, const std::string& map_ext) {
+    if (path.ends_with(".sgy") || path.ends_with(".segy")) {
+        std::cout << "Opening " << what << " SEG-Y file..." << std::endl;
+
+        // Тот же "умный" подход, что и для входного файла
+        const std::string db_path = path + ".cdp" + map_ext;
+        const std::string map_name = "cdp_map";
+        const std::vector<std::string> map_keys = {"CDP"};
+
+        if (!std::filesystem::exists(db_path)) {
+            std::cout << "Trace map for " << what << " file not found. Building new one..." << std::endl;
+            SegyReader temp_reader(path);
+            temp_reader.build_tracemap(map_name, db_path, map_keys, map_backend);
         }
 
-        const auto& pairs = use->second;
-        std::vector<float> v(n);
-        for (int i = 0; i < n; ++i) {
-            float t = i * dt;
-
-            auto upper = std::lower_bound(
-                pairs.begin(), pairs.end(), std::make_pair(t, 0.0f),
-                [](const auto& a, const auto& b) { return a.first < b.first; });
-
-            if (upper == pairs.end()) {
-                v[i] = pairs.back().second;
-            } else if (upper == pairs.begin()) {
-                v[i] = pairs.front().second;
-            } else {
-                auto lower = std::prev(upper);
-                float t1 = lower->first, v1 = lower->second;
-                float t2 = upper->first, v2 = upper->second;
-                float alpha = (t - t1) / (t2 - t1 + 1e-6f);
-                v[i] = v1 + alpha * (v2 - v1);
+        // Ридер живет, пока поле загружает контрольные трассы
+        auto reader = std::make_shared<SegyReader>(path);
+        reader->update_tracemap(map_name, db_path, map_keys, map_backend);
+        std::shared_ptr<TraceMap> map = reader->get_tracemap(map_name);
+
+        auto loader = [reader, map, dt](int cdp) {
+            std::vector<int> indices = map->find_trace_indices({cdp});
+            std::vector<float> trace = reader->get_trace(*std::min_element(indices.begin(), indices.end()));
+            std::vector<std::pair<float, float>> points(trace.size());
+            for (size_t i = 0; i < trace.size(); ++i) {
+                points[i] = {i * dt, trace[i]};
             }
-        }
-        result[cdp] = std::move(v);
+            return points;
+        };
+        return std::make_unique<VelocityField>(map->get_unique_values("CDP"), loader, num_samples, dt);
     }
 
-    return result;
+    std::cout << "Reading " << what << " from table file..." << std::endl;
+    return std::make_unique<VelocityField>(read_velocity_table(path), num_samples, dt);
 }
 
-// ------------------- Суммирование -------------------------
-std::vector<float> stack_traces(const std::vector<std::vector<float>>& traces) {
-    if (traces.empty()) return {};
-    int n = traces[0].size();
-    int m = traces.size();
-    std::vector<float> out(n, 0.0f);
-    float inv_m = 1.0f / m;
-
-    #pragma omp parallel for
-    for (int i = 0; i < n; ++i) {
-        float sum = 0.0f;
-        for (int j = 0; j < m; ++j) {
-            sum += traces[j][i];
+// Источник функций CDP: бинарное хранилище (span в отображение) или поле
+struct CdpFunctions {
+    std::unique_ptr<VelocityStore> store;
+    std::unique_ptr<VelocityField> field;
+
+    // hold держит функцию поля, пока жив span
+    std::span<const float> at(int cdp, std::shared_ptr<const std::vector<float>>& hold) const {
+        if (store) return store->at(cdp);
+        hold = field->at(cdp);
+        return *hold;
+    }
+};
+
+// С use_store хранилище path + ".velstore" строится для cdp_values, если его нет или оно устарело
+CdpFunctions open_cdp_functions(const std::string& path, const std::string& what, const std::vector<int>& cdp_values,
+                                int num_samples, float dt, bool use_store, TraceMapBackend map_backend,
+                                const std::string& map_ext) {
+    CdpFunctions functions;
+    if (!use_store) {
+        functions.field = open_velocity_field(path, what, num_samples, dt, map_backend, map_ext);
+        return functions;
+    }
+
+    const std::string store_path = path + ".velstore";
+    const SourceFingerprint source = VelocityStore::source_fingerprint(path);
+    if (std::filesystem::exists(store_path)) {
+        try {
+            auto store = std::make_unique<VelocityStore>(store_path);
+            if (store->matches(source, num_samples, dt) &&
+                std::all_of(cdp_values.begin(), cdp_values.end(), [&](int cdp) { return !store->at(cdp).empty(); })) {
+                std::cout << "Found existing " << what << " store." << std::endl;
+                functions.store = std::move(store);
+                return functions;
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Warning: " << e.what() << "\n";
         }
-        out[i] = sum * inv_m;
+        std::cout << "Store for " << what << " is out of date. Rebuilding..." << std::endl;
+    } else {
+        std::cout << "Store for " << what << " not found. Building new one..." << std::endl;
+    }
+    auto field = open_velocity_field(path, what, num_samples, dt, map_backend, map_ext);
+    VelocityStore::build(store_path, *field, cdp_values, dt, source);
+    functions.store = std::make_unique<VelocityStore>(store_path);
+    return functions;
+}
+
+// ------------------- Анализ скоростей ---------------------
+// Семблансные панели выбранных CDP: трасса на каждую пробную скорость;
+// скорость записывается в поле offset, ее номер (с 1) - в CDP_TRACE
+void run_velocity_analysis(const Config& cfg, const SegyReader& reader, const TraceMap& tmap,
+                           const std::vector<int>& cdp_values,
+                           const std::vector<std::optional<KeyRange>>& gather_ranges,
+                           const NmoEngine& nmo_prototype, float dt) {
+    std::vector<int> selected;
+    if (!cfg.va_cdps.empty()) {
+        for (int cdp : cfg.va_cdps) {
+            if (std::binary_search(cdp_values.begin(), cdp_values.end(), cdp)) selected.push_back(cdp);
+        }
+        std::sort(selected.begin(), selected.end());
+        selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+    } else {
+        for (size_t i = 0; i < cdp_values.size(); i += cfg.va_cdp_step) selected.push_back(cdp_values[i]);
     }
 
-    return out;
+    SemblanceOptions options;
+    options.velocity_min = cfg.va_velocity_min;
+    options.velocity_max = cfg.va_velocity_max;
+    options.velocity_step = cfg.va_velocity_step;
+    options.window = 2 * static_cast<int>(std::lround(cfg.va_window_ms * 1e-3f / dt / 2)) + 1;
+    options.stretch_mute_percent = cfg.nmo_stretch_muting_percent;
+    const std::vector<float> velocities = trial_velocities(options);
+    const int num_selected = selected.size();
+    std::cout << "Velocity analysis of " << num_selected << " CDPs: " << velocities.size() << " trial velocities from "
+              << velocities.front() << " to " << velocities.back() << " m/s, window " << options.window
+              << " samples." << std::endl;
+
+    // Трассы каждой выбранной CDP в диапазоне удалений читает фоновый поток
+    GatherStreamOptions prefetch;
+    prefetch.prefetch_depth = cfg.prefetch_depth;
+    prefetch.memory_limit = static_cast<size_t>(cfg.prefetch_memory_mb) << 20;
+    GatherStream gathers(reader,
+        [&tmap, &selected, ranges = gather_ranges, next = size_t(0)]
+        (std::vector<int>& key, std::vector<int>& indices) mutable {
+            if (next == selected.size()) return false;
+            const int cdp = selected[next++];
+            ranges[0] = KeyRange{cdp, cdp};
+            key.assign(1, cdp);
+            indices = tmap.find_trace_indices_where(ranges);
+            return true;
+        },
+        prefetch);
+
+    // Тот же конвейер, что и для суммирования: рабочий поток строит панель CDP целиком
+    struct SemblancePanel {
+        std::vector<uint8_t> header;
+        Gather panel; // Пусто, если у CDP нет трасс
+    };
+    PipelineOptions pipeline;
+    pipeline.reorder_window = cfg.reorder_window;
+
+    SegyWriter writer(cfg.output_file, reader, sample_format_from_code(cfg.output_sample_format));
+    int done = 0;
+    run_gather_pipeline<SemblancePanel>(gathers, pipeline,
+        [&] {
+            return [&, scanner = SemblanceScanner(nmo_prototype, options, dt), offsets = std::vector<float>()]
+                   (const StreamedGather& item, SemblancePanel& out) mutable {
+                const Gather& gather = item.gather;
+                if (gather.empty()) {
+                    return;
+                }
+
+                constexpr FieldInfo OFFSET_FIELD = trace_field("offset");
+                offsets.resize(gather.num_traces());
+                for (int i = 0; i < gather.num_traces(); ++i) {
+                    offsets[i] = static_cast<float>(read_header_field(gather.header(i), OFFSET_FIELD));
+                }
+                out.header.assign(gather.header(0), gather.header(0) + Gather::HEADER_SIZE);
+                out.panel.resize(static_cast<int>(velocities.size()), gather.num_samples());
+                for (size_t v = 0; v < velocities.size(); ++v) {
+                    scanner.scan(gather, offsets, velocities[v], out.panel.trace(static_cast<int>(v)));
+                }
+            };
+        },
+        [&](SemblancePanel& result) {
+            constexpr FieldInfo OFFSET_FIELD = trace_field("offset");
+            constexpr FieldInfo NUMBER_FIELD = trace_field("CDP_TRACE");
+            Gather& panel = result.panel;
+            for (int v = 0; v < panel.num_traces(); ++v) {
+                uint8_t* header = panel.header(v);
+                std::copy(result.header.begin(), result.header.end(), header);
+                write_header_field(header, OFFSET_FIELD, static_cast<int32_t>(std::lround(velocities[v])));
+                write_header_field(header, NUMBER_FIELD, v + 1);
+            }
+            if (!panel.empty()) writer.write_gather(panel);
+            print_progress_bar("Velocity analysis", ++done, num_selected);
+        });
+    print_progress_bar("Velocity analysis", num_selected, num_selected);
 }
 
 // ------------------------ main ----------------------------
@@ -146,35 +262,53 @@ int main(int argc, char** argv) {
    
     std::cout << "Input:    " << cfg.input_file << std::endl;
     std::cout << "Output:   " << cfg.output_file << std::endl;
-    std::cout << "Velocity: " << cfg.velocity_file << std::endl;
+    if (cfg.velocity_analysis) {
+        std::cout << "Mode:     velocity analysis" << std::endl;
+    } else {
+        std::cout << "Velocity: " << cfg.velocity_file << std::endl;
+        if (cfg.moveout_law != "hyperbolic") {
+            std::cout << "Eta:      " << cfg.eta_file << " (" << cfg.moveout_law << " moveout)" << std::endl;
+        }
+    }
     
     // --- ИЗМЕНЕНИЕ: Упрощенная проверка файлов, т.к. конструкторы Segy* сами вызовут ошибку ---
     if (!std::filesystem::exists(cfg.input_file)) {
         std::cerr << "Error: Cannot find input SEG-Y file: " << cfg.input_file << std::endl;
         return 2;
     }
-    if (!std::filesystem::exists(cfg.velocity_file)) {
+    if (!cfg.velocity_analysis && !std::filesystem::exists(cfg.velocity_file)) {
         std::cerr << "Error: Cannot find velocity file: " << cfg.velocity_file << std::endl;
         return 3;
     }
+    if (!cfg.velocity_analysis && cfg.moveout_law != "hyperbolic" && !std::filesystem::exists(cfg.eta_file)) {
+        std::cerr << "Error: Cannot find eta file: " << cfg.eta_file << std::endl;
+        return 3;
+    }
     
     // --- ИЗМЕНЕНИЕ: Новый, явный подход к созданию/загрузке карты трасс ---
-    const std::string main_db_path = cfg.input_file + ".cdp_offset.sqlite";
+    // Бинарный индекс хранится в отдельном файле, чтобы не путать его с базой SQLite
+    const TraceMapBackend map_backend = cfg.binary_tracemap ? TraceMapBackend::Binary : TraceMapBackend::SQLite;
+    const std::string map_ext = cfg.binary_tracemap ? ".tidx" : ".sqlite";
+    const std::string main_db_path = cfg.input_file + ".cdp_offset" + map_ext;
     const std::string main_map_name = "cdp_offset_map";
     const std::vector<std::string> main_map_keys = {"CDP", "offset"};
 
+    const IoBackend io_backend = cfg.use_mmap ? IoBackend::Mmap : IoBackend::Pread;
     if (!std::filesystem::exists(main_db_path)) {
         std::cout << "\nTrace map for input file not found. Building new one..." << std::endl;
-        SegyReader temp_reader(cfg.input_file);
-        temp_reader.build_tracemap(main_map_name, main_db_path, main_map_keys);
+        SegyReader temp_reader(cfg.input_file, "r", io_backend);
+        temp_reader.advise(AccessPattern::Sequential);
+        temp_reader.build_tracemap(main_map_name, main_db_path, main_map_keys, map_backend);
     } else {
         std::cout << "\nFound existing trace map for input file." << std::endl;
     }
 
     // --- Основная часть программы ---
-    // Создаем ридер и ЗАГРУЖАЕМ в него уже готовую карту
-    SegyReader input_reader(cfg.input_file);
-    input_reader.load_tracemap(main_map_name, main_db_path, main_map_keys);
+    // Создаем ридер и загружаем в него карту. Если файл дописан после построения карты,
+    // сканируются только новые трассы; перезаписанный файл индексируется заново.
+    SegyReader input_reader(cfg.input_file, "r", io_backend);
+    input_reader.set_read_gap_tolerance(cfg.read_gap_tolerance);
+    input_reader.update_tracemap(main_map_name, main_db_path, main_map_keys, map_backend);
     
     int num_samples = input_reader.num_samples();
     float dt = input_reader.sample_interval() * 1e-6f;
@@ -182,83 +316,115 @@ int main(int argc, char** argv) {
     // Получаем уникальные CDP, используя новый API
     auto tmap = input_reader.get_tracemap(main_map_name);
     auto cdp_values = tmap->get_unique_values("CDP");
+
+    // Фильтры из конфигурации: диапазон CDP и диапазон удалений
+    std::vector<std::optional<KeyRange>> gather_ranges(main_map_keys.size());
+    if (cfg.min_cdp || cfg.max_cdp) {
+        KeyRange cdp_range{cfg.min_cdp.value_or(std::numeric_limits<int>::min()),
+                           cfg.max_cdp.value_or(std::numeric_limits<int>::max())};
+        std::erase_if(cdp_values, [&](int cdp) { return cdp < cdp_range.first || cdp > cdp_range.last; });
+        gather_ranges[0] = cdp_range;
+    }
+    if (cfg.min_offset || cfg.max_offset) {
+        gather_ranges[1] = KeyRange{cfg.min_offset.value_or(std::numeric_limits<int>::min()),
+                                    cfg.max_offset.value_or(std::numeric_limits<int>::max())};
+    }
     int num_cdps = cdp_values.size();
     
     std::cout << "Found " << num_cdps << " unique CDPs to process." << std::endl;
 
-    // --- Считывание и интерполяция скоростей ---
-    std::map<int, std::vector<float>> cdp_velocities;
-
-    if (cfg.velocity_file.ends_with(".sgy") || cfg.velocity_file.ends_with(".segy")) {
-        std::cout << "Reading velocities from SEG-Y file..." << std::endl;
-        
-        // ИЗМЕНЕНИЕ: Тот же "умный" подход для файла скоростей
-        const std::string vel_db_path = cfg.velocity_file + ".cdp.sqlite";
-        const std::string vel_map_name = "cdp_map";
-        const std::vector<std::string> vel_map_keys = {"CDP"};
-
-        if (!std::filesystem::exists(vel_db_path)) {
-            std::cout << "Trace map for velocity file not found. Building new one..." << std::endl;
-            SegyReader temp_vel_reader(cfg.velocity_file);
-            temp_vel_reader.build_tracemap(vel_map_name, vel_db_path, vel_map_keys);
-        }
-        
-        // Создаем ридер для файла скоростей и загружаем его карту
-        SegyReader vel_reader(cfg.velocity_file);
-        vel_reader.load_tracemap(vel_map_name, vel_db_path, vel_map_keys);
-
-        for (int cdp : cdp_values) {
-            auto g = vel_reader.get_gather(vel_map_name, {cdp});
-            if (!g.empty()) {
-                cdp_velocities[cdp] = g[0];
-            }
-        }
-        
-        // Интерполяция/экстраполяция (без изменений)
-        VelTable table;
-        for (const auto& [cdp, vec] : cdp_velocities) {
-            table[cdp].clear();
-            for (size_t i = 0; i < vec.size(); ++i)
-                table[cdp].emplace_back(i * dt, vec[i]);
-        }
-        cdp_velocities = interpolate_velocity_cube(table, cdp_values, num_samples, dt);
+    NmoInterpolationOptions interpolation;
+    interpolation.mode = nmo_interpolation_from_name(cfg.nmo_interpolation);
+    interpolation.sinc_taps = cfg.sinc_taps;
+    interpolation.table_resolution = cfg.interpolation_table_resolution;
+    // Анализ скоростей сканирует гиперболы
+    const MoveoutLaw law = cfg.velocity_analysis ? MoveoutLaw::Hyperbolic : moveout_law_from_name(cfg.moveout_law);
+    const NmoEngine nmo_prototype(interpolation, law); // Проверяет параметры до начала обработки
+
+    if (cfg.velocity_analysis) {
+        run_velocity_analysis(cfg, input_reader, *tmap, cdp_values, gather_ranges, nmo_prototype, dt);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+        std::cout << "\nVelocity analysis finished. Semblance panels written to: " << cfg.output_file << "\n";
+        std::cout << "Total processing time: " << std::fixed << std::setprecision(2) << elapsed.count() << " seconds.\n";
+        return 0;
+    }
 
-    } else {
-        std::cout << "Reading velocities from table file..." <<std::endl;
-        VelTable table = read_velocity_table(cfg.velocity_file);
-        std::cout << "Interpolating velocity..." << std::endl;
-        cdp_velocities = interpolate_velocity_cube(table, cdp_values, num_samples, dt);
+    // --- Считывание и интерполяция скоростей (и eta для негиперболических законов) ---
+    const CdpFunctions velocity_functions = open_cdp_functions(
+        cfg.velocity_file, "velocities", cdp_values, num_samples, dt, cfg.velocity_store, map_backend, map_ext);
+    CdpFunctions eta_functions;
+    if (law != MoveoutLaw::Hyperbolic) {
+        eta_functions = open_cdp_functions(cfg.eta_file, "eta", cdp_values, num_samples, dt, cfg.velocity_store,
+                                           map_backend, map_ext);
     }
 
     // --- Основной цикл обработки и записи ---
-    SegyWriter writer(cfg.output_file, input_reader);
+    SegyWriter writer(cfg.output_file, input_reader, sample_format_from_code(cfg.output_sample_format));
     std::cout << "\nStarting NMO correction and stacking..." << std::endl;
 
-    int processed = 0;
-    for (int cdp : cdp_values) {
-        print_progress_bar("Processing CDPs", ++processed, num_cdps);
-
-        std::vector<std::vector<uint8_t>> headers;
-        std::vector<std::vector<float>> traces;
-        // ИЗМЕНЕНИЕ: get_gather_and_headers теперь не требует TraceMap в качестве аргумента
-        input_reader.get_gather_and_headers(main_map_name, {cdp, std::nullopt}, headers, traces);
-
-        if (traces.empty() || cdp_velocities.find(cdp) == cdp_velocities.end()) {
-            continue;
-        }
-
-        std::vector<float> offsets;
-        offsets.reserve(headers.size());
-        for (const auto& h : headers) {
-            offsets.push_back(static_cast<float>(input_reader.get_header_value_i32(h, "offset")));
-        }
-
-        auto corrected = nmo_correction(traces, offsets, cdp_velocities.at(cdp), dt, cfg.nmo_stretch_muting_percent);
-        auto stacked = stack_traces(corrected);
-
-        // Используем заголовок первой трассы сейсмосбора как шаблон для суммарной трассы
-        writer.write_trace(headers.front(), stacked);
-    }
+    // Конвейер: фоновый поток читает сейсмосборы CDP из курсора по возрастанию CDP
+    // (один упорядоченный проход по карте; CDP без трасс в диапазоне удалений пропускаются),
+    // рабочие потоки обрабатывают каждый CDP целиком, поток записи выводит суммы в порядке CDP.
+    struct StackedCdp {
+        int cdp = 0;
+        std::vector<uint8_t> header;
+        std::vector<float> trace; // Пусто, если CDP не суммировался
+    };
+
+    GatherStreamOptions prefetch;
+    prefetch.prefetch_depth = cfg.prefetch_depth;
+    prefetch.memory_limit = static_cast<size_t>(cfg.prefetch_memory_mb) << 20;
+    auto gathers = input_reader.stream_gathers(tmap->open_cursor(1, gather_ranges), prefetch);
+
+    PipelineOptions pipeline;
+    pipeline.reorder_window = cfg.reorder_window;
+
+    int written_cdps = 0;
+    run_gather_pipeline<StackedCdp>(gathers, pipeline,
+        [&] {
+            // Движок и буферы переиспользуются рабочим потоком для всех его CDP
+            return [&, nmo = nmo_prototype, fold = std::vector<int>(), offsets = std::vector<float>(),
+                    velocity_hold = std::shared_ptr<const std::vector<float>>(),
+                    eta_hold = std::shared_ptr<const std::vector<float>>()]
+                   (const StreamedGather& item, StackedCdp& out) mutable {
+                const Gather& gather = item.gather;
+                out.cdp = item.key[0];
+                if (gather.empty()) {
+                    return;
+                }
+
+                constexpr FieldInfo OFFSET_FIELD = trace_field("offset");
+                offsets.resize(gather.num_traces());
+                for (int i = 0; i < gather.num_traces(); ++i) {
+                    offsets[i] = static_cast<float>(read_header_field(gather.header(i), OFFSET_FIELD));
+                }
+
+                const std::span<const float> velocities = velocity_functions.at(out.cdp, velocity_hold);
+                const std::span<const float> eta =
+                    law != MoveoutLaw::Hyperbolic ? eta_functions.at(out.cdp, eta_hold) : std::span<const float>();
+                nmo.set_velocity(velocities, dt, cfg.nmo_stretch_muting_percent, eta);
+                // Поправка и суммирование за один проход, нормировка на живую кратность отсчета
+                const int stacked = nmo.apply_and_stack(gather, offsets, out.trace, fold);
+
+                // Используем заголовок первой трассы сейсмосбора как шаблон для суммарной трассы
+                out.header.assign(gather.header(0), gather.header(0) + Gather::HEADER_SIZE);
+                if (cfg.stack_fold_header) {
+                    constexpr FieldInfo FOLD_FIELD = trace_field("NStackedTraces");
+                    write_header_field(out.header.data(), FOLD_FIELD, stacked);
+                }
+            };
+        },
+        [&](StackedCdp& result) {
+            if (!result.trace.empty()) {
+                writer.write_trace(result.header, result.trace);
+            }
+            constexpr int PROGRESS_STEP = 256;
+            if (++written_cdps % PROGRESS_STEP == 0) {
+                int done = std::upper_bound(cdp_values.begin(), cdp_values.end(), result.cdp) - cdp_values.begin();
+                print_progress_bar("Processing CDPs", done, num_cdps);
+            }
+        });
+    print_progress_bar("Processing CDPs", num_cdps, num_cdps);
 
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end_time - start_time;
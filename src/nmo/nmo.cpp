@@ -1,79 +1,640 @@
 #include <algorithm>
+#include <bit>
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include <numeric>
 #include <stdexcept>
 #include <string>
+#include <immintrin.h>
 #include <omp.h>
 #include "nmo/nmo.hpp"
+#include "pipeline/ParallelTasks.hpp"
 
-std::vector<std::vector<float>> 
-nmo_correction(const std::vector<std::vector<float>>& cdp_gather,
-               const std::vector<float>& offsets,
-               const std::vector<float>& velocities,
-               float dt,
-               float stretch_mute_percent
-               ) {
+namespace {
 
-    int n_traces = static_cast<int>(cdp_gather.size());
-    if (n_traces == 0) return {};
+// --- Функции интерполяции: вес точки на расстоянии x отсчетов от NMO-времени ---
 
-    int n_time_samples = static_cast<int>(cdp_gather[0].size());
-    std::vector<std::vector<float>> nmo_corrected_gather(n_traces, std::vector<float>(n_time_samples, 0.0f));
+// Модифицированная функция Бесселя нулевого порядка (ряд), для окна Кайзера
+double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64 && term > 1e-12 * sum; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// sinc с окном Кайзера полушириной half_width
+constexpr double KAISER_BETA = 6.0;
+
+double windowed_sinc(double x, double half_width) {
+    const double r = x / half_width;
+    if (std::fabs(r) >= 1.0) return 0.0;
+    const double sinc = (x == 0.0) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+    return sinc * bessel_i0(KAISER_BETA * std::sqrt(1.0 - r * r)) / bessel_i0(KAISER_BETA);
+}
+
+// Кубическая свертка Кейса (a = -0.5)
+double keys_cubic(double x) {
+    constexpr double a = -0.5;
+    x = std::fabs(x);
+    if (x <= 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    if (x < 2.0) return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+    return 0.0;
+}
+
+double linear_hat(double x) {
+    return std::max(0.0, 1.0 - std::fabs(x));
+}
+
+// Отметка NMO-времени, не представимого в int; с запасом, чтобы вычитание не переполнялось
+constexpr int32_t UNREPRESENTABLE_TIME = std::numeric_limits<int32_t>::min() / 2;
+
+// Кинематика и растяжение считаются без приближенных векторных деления и корня (RCPPS/RSQRTPS)
+// и без слияния умножения со сложением, чтобы векторный цикл давал те же числа, что поотсчетный расчет
+#define NMO_EXACT_MATH __attribute__((optimize("no-unsafe-math-optimizations", "fp-contract=off")))
 
-    // Предрасчёт sinc-функции
-    constexpr int SINC_HALF_WINDOW = 4;
-    constexpr int SINC_WINDOW_SIZE = 2 * SINC_HALF_WINDOW + 1;
-    std::vector<float> sinc_weights(SINC_WINDOW_SIZE);
-    for (int k = 0; k < SINC_WINDOW_SIZE; ++k) {
-        float x = static_cast<float>(k - SINC_HALF_WINDOW);
-        sinc_weights[k] = (x == 0.0f) ? 1.0f : std::sin(M_PI * x) / (M_PI * x);
+// Законы кинематики: квадрат NMO-времени по t0, v^2, eta и x^2
+
+// Гипербола t0^2 + x^2 / v^2 (t0 * t0 + x^2 / v^2 одним fma, как в прежнем поотсчетном расчете)
+struct HyperbolicMoveout {
+    NMO_EXACT_MATH static float time2(float t, float velocity2, float, float offset2) {
+        return __builtin_fmaf(t, t, offset2 / velocity2);
     }
+};
 
-    // Основной цикл — параллелим по трассам
-    #pragma omp parallel for schedule(dynamic)
-    for (int i = 0; i < n_traces; ++i) {
-        const auto& trace = cdp_gather[i];
-        auto& corrected_trace = nmo_corrected_gather[i];
-        float offset = offsets[i];
+// Алхалифа - Цванкин: гипербола - 2 eta x^4 / (v^2 (t0^2 v^2 + (1 + 2 eta) x^2))
+struct EtaMoveout {
+    NMO_EXACT_MATH static float time2(float t, float velocity2, float eta, float offset2) {
+        const float hyperbola = __builtin_fmaf(t, t, offset2 / velocity2);
+        const float denominator = velocity2 * (t * t * velocity2 + (1.0f + 2.0f * eta) * offset2);
+        const float correction = denominator > 0.0f ? 2.0f * eta * offset2 * offset2 / denominator : 0.0f;
+        return __builtin_fmaxf(hyperbola - correction, 0.0f);
+    }
+};
+
+// Ряд Тейлора 4-го порядка по x: гипербола + A4 x^4, A4 = -2 eta / (t0^2 v^4)
+struct QuarticMoveout {
+    NMO_EXACT_MATH static float time2(float t, float velocity2, float eta, float offset2) {
+        const float hyperbola = __builtin_fmaf(t, t, offset2 / velocity2);
+        const float denominator = t * t * velocity2 * velocity2;
+        const float a4 = denominator > 0.0f ? -2.0f * eta / denominator : 0.0f;
+        return __builtin_fmaxf(hyperbola + a4 * offset2 * offset2, 0.0f);
+    }
+};
 
-        for (int j = 0; j < n_time_samples; ++j) {
-            float time = j * dt;
-            float velocity = velocities[j];
-            if (velocity == 0.0f) velocity = 1e-12f;
+// NMO-время в долях 1 / phases отсчета, round(sqrt(Law::time2) / dt * phases), для каждого отсчета t.
+// Для гиперболы при phases = 1 номера отсчетов совпадают с прежним поотсчетным расчетом побитно
+// (умножение на 1 / dt, округление прибавлением ближайшего к 0.5 снизу числа и отбрасыванием дроби).
+// Время, не представимое в int (нулевая скорость), как и при прежнем преобразовании cvttss2si,
+// дает отрицательное значение: такой отсчет не обрывает трассу, а мьютится или берется с края.
+// Закон - параметр шаблона, поэтому у каждого закона свой цикл без ветвлений.
+template <typename Law>
+NMO_EXACT_MATH void moveout_samples(const float* time, const float* velocity2, const float* eta, float offset2,
+                                    float inv_dt, float phases, int32_t* out, int n) {
+    #pragma omp simd
+    for (int j = 0; j < n; ++j) {
+        float tnmo = __builtin_sqrtf(Law::time2(time[j], velocity2[j], eta[j], offset2));
+        float sample = tnmo * inv_dt * phases + 0.49999997f;
+        out[j] = sample < 2147483520.0f ? static_cast<int32_t>(sample) : UNREPRESENTABLE_TIME;
+    }
+}
 
-            float tnmo = std::sqrt(time * time + (offset * offset) / (velocity * velocity));
-            int tnmo_sample = static_cast<int>(std::round(tnmo / dt));
+// Растяжение (1 - t / tnmo) * 100 превышает порог: в той же арифметике, что и moveout_samples
+template <typename Law>
+NMO_EXACT_MATH bool stretch_muted(float time, float velocity2, float eta, float offset2, float stretch_mute_percent) {
+    float tnmo = __builtin_sqrtf(Law::time2(time, velocity2, eta, offset2));
+    float stretch = tnmo > 0.0f ? (1.0f - time / tnmo) * 100.0f : 0.0f;
+    return stretch > stretch_mute_percent;
+}
 
-            if (tnmo_sample >= n_time_samples) {
-                std::fill(corrected_trace.begin() + j, corrected_trace.end(), 0.0f);
-                break;
-            }
+// Признаки мьютинга для каждого отсчета
+template <typename Law>
+NMO_EXACT_MATH void stretch_mute_flags(const float* time, const float* velocity2, const float* eta, float offset2,
+                                       float stretch_mute_percent, uint8_t* muted, int n) {
+    #pragma omp simd
+    for (int j = 0; j < n; ++j) {
+        muted[j] = stretch_muted<Law>(time[j], velocity2[j], eta[j], offset2, stretch_mute_percent);
+    }
+}
+
+// --- Ядра интерполяции: out[i] = sum_k coefs[row[i] + k] * trace[base[i] + k], k < taps ---
+
+void interpolate_scalar(const float* trace, const int32_t* base, const int32_t* row, const float* coefs, int taps,
+                        float* out, int count) {
+    if (taps == 1) {
+        // Ближайший отсчет: цикл векторизуется со сбором
+        for (int i = 0; i < count; ++i) {
+            out[i] = trace[base[i]] * coefs[row[i]];
+        }
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        const float* src = trace + base[i];
+        const float* c = coefs + row[i];
+        float acc = 0.0f;
+        #pragma omp simd reduction(+:acc)
+        for (int k = 0; k < taps; ++k) {
+            acc += src[k] * c[k];
+        }
+        out[i] = acc;
+    }
+}
+
+// Точки фильтра подряд в памяти: окно трассы и строка коэффициентов читаются
+// векторами, хвост фильтра - маскированной загрузкой
+
+// Частичные суммы окна отсчета: вектор из 8 слагаемых
+__attribute__((target("avx2,fma")))
+inline __m256 window_products(const float* src, const float* c, int full, int taps, __m256i tail) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int k = 0; k < full; k += 8) {
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(src + k), _mm256_loadu_ps(c + k), acc);
+    }
+    if (full < taps) {
+        acc = _mm256_fmadd_ps(_mm256_maskload_ps(src + full, tail), _mm256_maskload_ps(c + full, tail), acc);
+    }
+    return acc;
+}
+
+// Суммы восьми векторов одним деревом hadd: элемент i - сумма элементов v[i]
+__attribute__((target("avx2")))
+inline __m256 horizontal_sums(const __m256* v) {
+    const __m256 s01 = _mm256_hadd_ps(v[0], v[1]);
+    const __m256 s23 = _mm256_hadd_ps(v[2], v[3]);
+    const __m256 s45 = _mm256_hadd_ps(v[4], v[5]);
+    const __m256 s67 = _mm256_hadd_ps(v[6], v[7]);
+    const __m256 s0123 = _mm256_hadd_ps(s01, s23);
+    const __m256 s4567 = _mm256_hadd_ps(s45, s67);
+    return _mm256_add_ps(_mm256_permute2f128_ps(s0123, s4567, 0x20), _mm256_permute2f128_ps(s0123, s4567, 0x31));
+}
+
+__attribute__((target("avx2,fma")))
+void interpolate_avx2(const float* trace, const int32_t* base, const int32_t* row, const float* coefs, int taps,
+                      float* out, int count) {
+    if (taps == 1) {
+        interpolate_scalar(trace, base, row, coefs, taps, out, count);
+        return;
+    }
+    const int full = taps / 8 * 8;
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(taps - full), lanes);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 products[8];
+        for (int m = 0; m < 8; ++m) {
+            products[m] = window_products(trace + base[i + m], coefs + row[i + m], full, taps, tail);
+        }
+        _mm256_storeu_ps(out + i, horizontal_sums(products));
+    }
+    for (; i < count; ++i) {
+        const __m256 acc = window_products(trace + base[i], coefs + row[i], full, taps, tail);
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+        out[i] = _mm_cvtss_f32(sum);
+    }
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+void interpolate_avx512(const float* trace, const int32_t* base, const int32_t* row, const float* coefs, int taps,
+                        float* out, int count) {
+    if (taps <= 8) {
+        // Окно помещается в 256 бит: дерево сумм AVX2 быстрее
+        interpolate_avx2(trace, base, row, coefs, taps, out, count);
+        return;
+    }
+    const int full = taps / 16 * 16;
+    const __mmask16 tail = static_cast<__mmask16>((1u << (taps - full)) - 1);
+    for (int i = 0; i < count; ++i) {
+        const float* src = trace + base[i];
+        const float* c = coefs + row[i];
+        __m512 acc = _mm512_setzero_ps();
+        for (int k = 0; k < full; k += 16) {
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(src + k), _mm512_loadu_ps(c + k), acc);
+        }
+        if (full < taps) {
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, src + full), _mm512_maskz_loadu_ps(tail, c + full), acc);
+        }
+        out[i] = _mm512_reduce_add_ps(acc);
+    }
+}
+
+#pragma GCC diagnostic pop
+
+// --- Выбор реализации ---
+
+struct NmoKernel {
+    void (*interpolate)(const float*, const int32_t*, const int32_t*, const float*, int, float*, int);
+    const char* name;
+};
+
+constexpr NmoKernel KERNEL_AVX512 = {interpolate_avx512, "avx512"};
+constexpr NmoKernel KERNEL_AVX2 = {interpolate_avx2, "avx2"};
+constexpr NmoKernel KERNEL_SCALAR = {interpolate_scalar, "scalar"};
+
+bool kernel_supported(const NmoKernel& k) {
+    // Короткие фильтры ядро AVX-512 передает ядру AVX2, поэтому оно тоже должно поддерживаться
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (&k == &KERNEL_AVX512) return avx2 && __builtin_cpu_supports("avx512f");
+    if (&k == &KERNEL_AVX2) return avx2;
+    return true;
+}
+
+const NmoKernel*& active_kernel() {
+    static const NmoKernel* kernel = [] {
+        for (const NmoKernel* k : {&KERNEL_AVX512, &KERNEL_AVX2}) {
+            if (kernel_supported(*k)) return k;
+        }
+        return &KERNEL_SCALAR;
+    }();
+    return kernel;
+}
+
+} // namespace
+
+// --- NmoEngine ---
+
+MoveoutLaw moveout_law_from_name(const std::string& name) {
+    if (name == "hyperbolic") return MoveoutLaw::Hyperbolic;
+    if (name == "eta") return MoveoutLaw::Eta;
+    if (name == "quartic") return MoveoutLaw::Quartic;
+    throw std::invalid_argument("Unknown moveout law (expected hyperbolic, eta or quartic): " + name);
+}
+
+NmoInterpolation nmo_interpolation_from_name(const std::string& name) {
+    if (name == "nearest") return NmoInterpolation::Nearest;
+    if (name == "linear") return NmoInterpolation::Linear;
+    if (name == "cubic") return NmoInterpolation::Cubic;
+    if (name == "sinc") return NmoInterpolation::Sinc;
+    throw std::invalid_argument("Unknown NMO interpolation (expected nearest, linear, cubic or sinc): " + name);
+}
+
+NmoEngine::NmoEngine(const NmoInterpolationOptions& options, MoveoutLaw law) : law_(law) {
+    double (*kernel)(double) = nullptr;
+    switch (options.mode) {
+    case NmoInterpolation::Nearest:
+        // Дробный сдвиг не нужен: NMO-время округляется до отсчета
+        taps_ = 1;
+        resolution_ = 1;
+        resolution_shift_ = 0;
+        coefs_ = {1.0f};
+        lead_ = 0;
+        return;
+    case NmoInterpolation::Linear:
+        taps_ = 2;
+        kernel = linear_hat;
+        break;
+    case NmoInterpolation::Cubic:
+        taps_ = 4;
+        kernel = keys_cubic;
+        break;
+    case NmoInterpolation::Sinc:
+        if (options.sinc_taps < 2 || options.sinc_taps > 64 || options.sinc_taps % 2 != 0) {
+            throw std::invalid_argument("sinc_taps must be even and within 2..64: " + std::to_string(options.sinc_taps));
+        }
+        taps_ = options.sinc_taps;
+        break;
+    }
+    const int resolution = options.table_resolution;
+    if (resolution < 1 || resolution > 1024 || (resolution & (resolution - 1)) != 0) {
+        throw std::invalid_argument("Interpolation table resolution must be a power of two within 1..1024: " +
+                                    std::to_string(resolution));
+    }
+    resolution_ = resolution;
+    resolution_shift_ = std::countr_zero(static_cast<unsigned>(resolution));
+    lead_ = taps_ / 2 - 1;
+
+    // Строка phase - коэффициенты для NMO-времени i + phase / resolution_, точка k
+    // берет отсчет i - lead_ + k. Сумма строки нормируется к 1, чтобы постоянный сигнал не менялся.
+    coefs_.resize(static_cast<size_t>(resolution_) * taps_);
+    const double half_width = taps_ / 2.0;
+    for (int phase = 0; phase < resolution_; ++phase) {
+        const double frac = static_cast<double>(phase) / resolution_;
+        double w[64];
+        double sum = 0.0;
+        for (int k = 0; k < taps_; ++k) {
+            const double x = (k - lead_) - frac;
+            w[k] = kernel ? kernel(x) : windowed_sinc(x, half_width);
+            sum += w[k];
+        }
+        for (int k = 0; k < taps_; ++k) {
+            coefs_[static_cast<size_t>(phase) * taps_ + k] = static_cast<float>(w[k] / sum);
+        }
+    }
+}
+
+void NmoEngine::set_velocity(std::span<const float> velocities, float dt, float stretch_mute_percent,
+                             std::span<const float> eta) {
+    const size_t n = velocities.size();
+    if (!eta.empty() && eta.size() < n) {
+        throw std::invalid_argument("Eta function is shorter than the velocity function: " +
+                                    std::to_string(eta.size()) + " < " + std::to_string(n));
+    }
+    dt_ = dt;
+    stretch_mute_percent_ = stretch_mute_percent;
+    time_.resize(n);
+    velocity2_.resize(n);
+    tv_.resize(n);
+    eta_.assign(n, 0.0f);
+    for (size_t j = 0; j < n; ++j) {
+        float time = j * dt;
+        float velocity = velocities[j];
+        if (velocity == 0.0f) velocity = 1e-12f;
+        time_[j] = time;
+        velocity2_[j] = velocity * velocity;
+        tv_[j] = time * velocity;
+    }
+    tv_monotone_ = std::is_sorted(tv_.begin(), tv_.end());
+    if (!eta.empty()) std::copy(eta.begin(), eta.begin() + n, eta_.begin());
+}
+
+void NmoEngine::build_table(float offset, int n_samples, MoveoutTable& table) {
+    table.base.resize(n_samples);
+    table.row.resize(n_samples);
+    table.special_out.clear();
+    table.special_base.clear();
+    table.special_row.clear();
+    int32_t* base = table.base.data();
+    int32_t* row = table.row.data();
+
+    // Сначала в base - NMO-время в долях 1 / resolution_ отсчета. Закон выбирается один раз на таблицу
+    const float offset2 = offset * offset;
+    auto with_law = [&](auto&& body) {
+        switch (law_) {
+        case MoveoutLaw::Hyperbolic: body(HyperbolicMoveout{}); break;
+        case MoveoutLaw::Eta: body(EtaMoveout{}); break;
+        case MoveoutLaw::Quartic: body(QuarticMoveout{}); break;
+        }
+    };
+    with_law([&](auto law) {
+        moveout_samples<decltype(law)>(time_.data(), velocity2_.data(), eta_.data(), offset2, 1.0f / dt_,
+                                       static_cast<float>(resolution_), base, n_samples);
+    });
+
+    // Как и при поотсчетном расчете, трасса обрывается на первом отсчете за ее концом
+    const int64_t end_position = static_cast<int64_t>(n_samples) * resolution_;
+    table.live_end = static_cast<int>(std::find_if(base, base + n_samples,
+                                                   [end_position](int32_t q) { return q >= end_position; }) - base);
+
+    // Для гиперболы растяжение (1 - t / tnmo) * 100 > p равносильно t * v < r * |x| / sqrt(1 - r^2),
+    // где r = 1 - p / 100. При монотонной t * v зона мьютинга - начало трассы, и ее граница находится
+    // двоичным поиском. Порог вычислен в другой арифметике, поэтому граница уточняется поотсчетной
+    // проверкой соседних отсчетов. Иначе (другие законы, немонотонная t * v, p <= 0, где растяжение
+    // сравнивается с нулем и зависит от округления) мьютинг проверяется для каждого отсчета.
+    const float r = 1.0f - stretch_mute_percent_ / 100.0f;
+    const uint8_t* muted = nullptr;
+    if (law_ == MoveoutLaw::Hyperbolic && tv_monotone_ && r < 1.0f) {
+        auto muted_at = [&](int j) {
+            return stretch_muted<HyperbolicMoveout>(time_[j], velocity2_[j], 0.0f, offset2, stretch_mute_percent_);
+        };
+        float threshold = -std::numeric_limits<float>::infinity();
+        if (r > 0.0f && offset != 0.0f) {
+            threshold = r * std::fabs(offset) / std::sqrt(1.0f - r * r);
+        }
+        table.mute_end = static_cast<int>(std::lower_bound(tv_.begin(), tv_.begin() + n_samples, threshold) - tv_.begin());
+        while (table.mute_end > 0 && !muted_at(table.mute_end - 1)) --table.mute_end;
+        while (table.mute_end < n_samples && muted_at(table.mute_end)) ++table.mute_end;
+    } else {
+        muted_.resize(n_samples);
+        with_law([&](auto law) {
+            stretch_mute_flags<decltype(law)>(time_.data(), velocity2_.data(), eta_.data(), offset2,
+                                              stretch_mute_percent_, muted_.data(), n_samples);
+        });
+        muted = muted_.data();
+        table.mute_end = static_cast<int>(std::find(muted, muted + n_samples, 0) - muted);
+    }
 
-            float stretch_factor = (tnmo > 0.0f) ? (1.0f - time / tnmo) * 100.0f : 0.0f;
-            if (stretch_factor > stretch_mute_percent) {
-                corrected_trace[j] = 0.0f;
-                continue;
+    // Окно фильтра и строка коэффициентов для каждого отсчета; цикл без ветвлений векторизуется
+    const int32_t phase_mask = resolution_ - 1;
+    const int shift = resolution_shift_;
+    const int taps = taps_;
+    const int lead = lead_;
+    #pragma omp simd
+    for (int j = table.mute_end; j < table.live_end; ++j) {
+        const int32_t q = base[j];
+        base[j] = (q >> shift) - lead;
+        row[j] = (q & phase_mask) * taps;
+    }
+
+    // Отсчеты, которые векторное ядро не обработает: окно за краем трассы или мьютинг
+    // после начальной зоны мьютинга. Ядро все равно прочитает их окно, поэтому оно направляется в начало трассы.
+    const int32_t last_base = n_samples - taps_;
+    for (int j = table.mute_end; j < table.live_end; ++j) {
+        const bool mute = muted && muted[j];
+        if (mute || base[j] < 0 || base[j] > last_base) {
+            table.special_out.push_back(j);
+            table.special_base.push_back(std::max(base[j], -taps_));
+            table.special_row.push_back(mute ? -1 : row[j]);
+            base[j] = 0;
+            row[j] = 0;
+        }
+    }
+}
+
+void NmoEngine::correct_trace(const float* trace, const MoveoutTable& table, int n_samples, float* out) const {
+    const int begin = std::min(table.mute_end, table.live_end);
+    std::fill(out, out + begin, 0.0f);
+    // Короче фильтра трасса состоит только из краевых отсчетов
+    if (table.live_end > begin && n_samples >= taps_) {
+        active_kernel()->interpolate(trace, table.base.data() + begin, table.row.data() + begin, coefs_.data(), taps_,
+                                     out + begin, table.live_end - begin);
+    }
+    // У края трассы окно дополняется крайним отсчетом
+    for (size_t i = 0; i < table.special_out.size(); ++i) {
+        const int32_t coef_row = table.special_row[i];
+        float value = 0.0f;
+        if (coef_row >= 0) {
+            const int32_t first = table.special_base[i];
+            for (int k = 0; k < taps_; ++k) {
+                value += coefs_[coef_row + k] * trace[std::clamp(first + k, 0, n_samples - 1)];
             }
+        }
+        out[table.special_out[i]] = value;
+    }
+    std::fill(out + table.live_end, out + n_samples, 0.0f);
+}
 
-            int start_idx = tnmo_sample - SINC_HALF_WINDOW;
-            int end_idx = tnmo_sample + SINC_HALF_WINDOW;
+void NmoEngine::build_tables(const Gather& input, std::span<const float> offsets) {
+    const int n_traces = input.num_traces();
+    const int n_samples = input.num_samples();
+    if (static_cast<size_t>(n_samples) > time_.size()) {
+        throw std::invalid_argument("Velocity function is shorter than the traces: " +
+                                    std::to_string(time_.size()) + " < " + std::to_string(n_samples));
+    }
+    if (offsets.size() < static_cast<size_t>(n_traces)) {
+        throw std::invalid_argument("Expected " + std::to_string(n_traces) + " offsets, got " + std::to_string(offsets.size()));
+    }
 
-            if (start_idx < 0 || end_idx >= n_time_samples) {
-                corrected_trace[j] = trace[std::clamp(tnmo_sample, 0, n_time_samples - 1)];
-            } else {
-                float interpolated_value = 0.0f;
+    // Одна таблица на каждое различное удаление
+    unique_offsets_.assign(offsets.begin(), offsets.begin() + n_traces);
+    std::sort(unique_offsets_.begin(), unique_offsets_.end());
+    unique_offsets_.erase(std::unique(unique_offsets_.begin(), unique_offsets_.end()), unique_offsets_.end());
+    trace_table_.resize(n_traces);
+    for (int i = 0; i < n_traces; ++i) {
+        trace_table_[i] = static_cast<int>(std::lower_bound(unique_offsets_.begin(), unique_offsets_.end(), offsets[i]) -
+                                           unique_offsets_.begin());
+    }
+    if (tables_.size() < unique_offsets_.size()) tables_.resize(unique_offsets_.size());
 
-                #pragma omp simd reduction(+:interpolated_value)
-                for (size_t k = 0; k < sinc_weights.size(); ++k) {
-                    interpolated_value += trace[start_idx + k] * sinc_weights[k];
-                }
+    const int n_tables = static_cast<int>(unique_offsets_.size());
+    for (int u = 0; u < n_tables; ++u) {
+        build_table(unique_offsets_[u], n_samples, tables_[u]);
+    }
+}
+
+void NmoEngine::apply(const Gather& input, std::span<const float> offsets, Gather& output) {
+    build_tables(input, offsets);
+    const int n_traces = input.num_traces();
+    const int n_samples = input.num_samples();
+    output.resize(n_traces, n_samples);
+
+    for (int i = 0; i < n_traces; ++i) {
+        std::memcpy(output.header(i), input.header(i), Gather::HEADER_SIZE);
+        correct_trace(input.trace(i), tables_[trace_table_[i]], n_samples, output.trace(i));
+    }
+}
+
+int NmoEngine::accumulate(const Gather& input, std::span<const float> offsets,
+                          std::vector<float>& sum, std::vector<float>* energy, std::vector<int>& fold) {
+    build_tables(input, offsets);
+    const int n_traces = input.num_traces();
+    const int n_samples = input.num_samples();
+    sum.assign(n_samples, 0.0f);
+    if (energy) energy->assign(n_samples, 0.0f);
+    fold.assign(n_samples, 0);
+    scratch_.resize(n_samples);
+
+    // Вне [mute_end, live_end) исправленная трасса нулевая: прибавляется только живая часть
+    float* total = sum.data();
+    float* squares = energy ? energy->data() : nullptr;
+    const float* trace = scratch_.data();
+    for (int i = 0; i < n_traces; ++i) {
+        const MoveoutTable& table = tables_[trace_table_[i]];
+        correct_trace(input.trace(i), table, n_samples, scratch_.data());
+        #pragma omp simd
+        for (int j = table.mute_end; j < table.live_end; ++j) {
+            total[j] += trace[j];
+        }
+        if (squares) {
+            #pragma omp simd
+            for (int j = table.mute_end; j < table.live_end; ++j) {
+                squares[j] += trace[j] * trace[j];
+            }
+        }
+    }
 
-                corrected_trace[j] = interpolated_value;
+    // Кратность одинакова у всех трасс с одной таблицей
+    const int n_tables = static_cast<int>(unique_offsets_.size());
+    table_traces_.assign(n_tables, 0);
+    for (int i = 0; i < n_traces; ++i) {
+        ++table_traces_[trace_table_[i]];
+    }
+    int live_traces = 0;
+    int* count = fold.data();
+    for (int u = 0; u < n_tables; ++u) {
+        const MoveoutTable& table = tables_[u];
+        const int traces = table_traces_[u];
+        if (table.mute_end >= table.live_end) continue;
+        #pragma omp simd
+        for (int j = table.mute_end; j < table.live_end; ++j) {
+            count[j] += traces;
+        }
+        int muted = 0;
+        for (size_t k = 0; k < table.special_out.size(); ++k) {
+            if (table.special_row[k] < 0) {
+                count[table.special_out[k]] -= traces;
+                ++muted;
             }
         }
+        if (muted < table.live_end - table.mute_end) live_traces += traces;
+    }
+    return live_traces;
+}
+
+int NmoEngine::apply_and_stack(const Gather& input, std::span<const float> offsets,
+                               std::vector<float>& stack, std::vector<int>& fold) {
+    const int live_traces = accumulate(input, offsets, stack, nullptr, fold);
+    float* sum = stack.data();
+    const int* count = fold.data();
+    const int n_samples = input.num_samples();
+    #pragma omp simd
+    for (int j = 0; j < n_samples; ++j) {
+        sum[j] = count[j] > 0 ? sum[j] / static_cast<float>(count[j]) : 0.0f;
     }
+    return live_traces;
+}
+
+void nmo_stack_batch(std::span<NmoStackJob> jobs, std::span<NmoEngine> engines, float dt, float stretch_mute_percent) {
+    run_parallel_tasks(static_cast<int>(jobs.size()), engines, [&](int k, NmoEngine& engine) {
+        NmoStackJob& job = jobs[k];
+        engine.set_velocity(job.velocities, dt, stretch_mute_percent, job.eta);
+        job.stacked_traces = engine.apply_and_stack(*job.gather, job.offsets, job.stack, job.fold);
+    });
+}
+
+// --- Совместимые функции ---
+
+// Прежние функции сохраняют интерполяцию по ближайшему отсчету
+const NmoInterpolationOptions NEAREST_SAMPLE{NmoInterpolation::Nearest};
 
+std::vector<std::vector<float>>
+nmo_correction(const std::vector<std::vector<float>>& cdp_gather,
+               const std::vector<float>& offsets,
+               const std::vector<float>& velocities,
+               float dt,
+               float stretch_mute_percent
+               ) {
+
+    int n_traces = static_cast<int>(cdp_gather.size());
+    if (n_traces == 0) return {};
+
+    int n_time_samples = static_cast<int>(cdp_gather[0].size());
+    Gather input(n_traces, n_time_samples);
+    for (int i = 0; i < n_traces; ++i) {
+        std::copy(cdp_gather[i].begin(), cdp_gather[i].end(), input.trace(i));
+    }
+
+    NmoEngine engine(NEAREST_SAMPLE);
+    Gather corrected;
+    engine.set_velocity(velocities, dt, stretch_mute_percent);
+    engine.apply(input, offsets, corrected);
+
+    std::vector<std::vector<float>> nmo_corrected_gather(n_traces);
+    for (int i = 0; i < n_traces; ++i) {
+        nmo_corrected_gather[i].assign(corrected.trace(i), corrected.trace(i) + n_time_samples);
+    }
     return nmo_corrected_gather;
 }
 
+void nmo_correction(const Gather& cdp_gather,
+                    const std::vector<float>& offsets,
+                    const std::vector<float>& velocities,
+                    float dt,
+                    float stretch_mute_percent,
+                    Gather& output) {
+    NmoEngine engine(NEAREST_SAMPLE);
+    engine.set_velocity(velocities, dt, stretch_mute_percent);
+    engine.apply(cdp_gather, offsets, output);
+}
+
+const char* nmo_kernel() {
+    return active_kernel()->name;
+}
+
+bool set_nmo_kernel(const std::string& name) {
+    for (const NmoKernel* k : {&KERNEL_AVX512, &KERNEL_AVX2, &KERNEL_SCALAR}) {
+        if (name == k->name) {
+            if (!kernel_supported(*k)) return false;
+            active_kernel() = k;
+            return true;
+        }
+    }
+    return false;
+}
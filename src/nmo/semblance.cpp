@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "nmo/semblance.hpp"
+#include "pipeline/ParallelTasks.hpp"
+
+std::vector<float> trial_velocities(const SemblanceOptions& options) {
+    if (!(options.velocity_min > 0.0f) || !(options.velocity_step > 0.0f) ||
+        !(options.velocity_max >= options.velocity_min)) {
+        throw std::invalid_argument("Invalid semblance velocity range: " + std::to_string(options.velocity_min) + " to " +
+                                    std::to_string(options.velocity_max) + " step " +
+                                    std::to_string(options.velocity_step));
+    }
+    // Допуск, чтобы velocity_max вошла в панель несмотря на погрешность деления
+    const int count = static_cast<int>((options.velocity_max - options.velocity_min) / options.velocity_step + 1e-3f) + 1;
+    std::vector<float> velocities(count);
+    for (int k = 0; k < count; ++k) {
+        velocities[k] = options.velocity_min + k * options.velocity_step;
+    }
+    return velocities;
+}
+
+SemblanceScanner::SemblanceScanner(const NmoEngine& engine, const SemblanceOptions& options, float dt)
+    : engine_(engine),
+      half_window_(std::max(options.window, 1) / 2),
+      dt_(dt),
+      stretch_mute_percent_(options.stretch_mute_percent) {}
+
+void SemblanceScanner::scan(const Gather& gather, std::span<const float> offsets, float velocity, float* out) {
+    const int n = gather.num_samples();
+    velocity_.assign(n, velocity);
+    engine_.set_velocity(velocity_, dt_, stretch_mute_percent_);
+    engine_.accumulate(gather, offsets, sum_, &energy_, fold_);
+
+    // Скользящие суммы числителя и знаменателя по окну [j - half, j + half];
+    // в double, чтобы прибавление и вычитание не накапливали ошибку. Кратность
+    // в окне считается точно: без живых отсчетов сембланс равен нулю
+    auto numerator = [&](int j) { return static_cast<double>(sum_[j]) * sum_[j]; };
+    auto denominator = [&](int j) { return static_cast<double>(fold_[j]) * energy_[j]; };
+    double num = 0.0;
+    double den = 0.0;
+    long live = 0;
+    auto add = [&](int j, int sign) {
+        num += sign * numerator(j);
+        den += sign * denominator(j);
+        live += sign * fold_[j];
+    };
+    for (int j = 0; j < std::min(half_window_, n); ++j) {
+        add(j, 1);
+    }
+    for (int j = 0; j < n; ++j) {
+        if (j + half_window_ < n) add(j + half_window_, 1);
+        if (j - half_window_ - 1 >= 0) add(j - half_window_ - 1, -1);
+        out[j] = live > 0 && den > 0.0 ? static_cast<float>(std::clamp(num / den, 0.0, 1.0)) : 0.0f;
+    }
+}
+
+void semblance_batch(std::span<SemblanceJob> jobs, std::span<SemblanceScanner> scanners,
+                     const SemblanceOptions& options) {
+    const std::vector<float> velocities = trial_velocities(options);
+    const int n_velocities = static_cast<int>(velocities.size());
+    for (SemblanceJob& job : jobs) {
+        job.panel.resize(n_velocities, job.gather->num_samples());
+    }
+
+    // Задача - пара (CDP, пробная скорость)
+    run_parallel_tasks(static_cast<int>(jobs.size()) * n_velocities, scanners,
+                       [&](int task, SemblanceScanner& scanner) {
+                           SemblanceJob& job = jobs[task / n_velocities];
+                           const int k = task % n_velocities;
+                           scanner.scan(*job.gather, job.offsets, velocities[k], job.panel.trace(k));
+                       });
+}
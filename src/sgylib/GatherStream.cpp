@@ -0,0 +1,96 @@
+#include "sgylib/GatherStream.hpp"
+#include "sgylib/SegyReader.hpp"
+#include <algorithm>
+#include <utility>
+
+GatherStream::GatherStream(const SegyReader& reader, GatherSource source, GatherStreamOptions options)
+    : reader_(reader), source_(std::move(source)), options_(options) {
+    options_.prefetch_depth = std::max<std::size_t>(options_.prefetch_depth, 1);
+    worker_ = std::thread(&GatherStream::run, this);
+}
+
+GatherStream::~GatherStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    space_cv_.notify_all();
+    worker_.join();
+}
+
+std::size_t GatherStream::gather_bytes(const StreamedGather& item) {
+    const Gather& g = item.gather;
+    return static_cast<std::size_t>(g.num_traces()) * (g.stride() * sizeof(float) + Gather::HEADER_SIZE);
+}
+
+void GatherStream::run() {
+    std::vector<int> indices;
+    for (std::size_t ordinal = 0;; ++ordinal) {
+        std::unique_ptr<StreamedGather> item;
+        {
+            // Ждем места в очереди: пока ее не разберут до prefetch_depth и memory_limit
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_cv_.wait(lock, [this] {
+                return stop_ || (ready_.size() < options_.prefetch_depth &&
+                                 (ready_.empty() || ready_bytes_ < options_.memory_limit));
+            });
+            if (stop_) return;
+            if (!free_.empty()) {
+                item = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+        if (!item) item = std::make_unique<StreamedGather>();
+
+        bool have_gather = false;
+        try {
+            item->ordinal = ordinal;
+            item->key.clear();
+            indices.clear();
+            have_gather = source_(item->key, indices);
+            if (have_gather) reader_.read_gather(std::move(indices), item->gather);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+            have_gather = false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!have_gather) {
+                finished_ = true;
+            } else {
+                ready_bytes_ += gather_bytes(*item);
+                ready_.push_back(std::move(item));
+            }
+        }
+        if (!have_gather) {
+            // Конец потока должны увидеть все ждущие потребители
+            ready_cv_.notify_all();
+            return;
+        }
+        ready_cv_.notify_one();
+    }
+}
+
+std::unique_ptr<StreamedGather> GatherStream::next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [this] { return !ready_.empty() || finished_; });
+    if (ready_.empty()) {
+        // Ошибка отдается один раз, после всех успешно прочитанных сейсмосборов
+        if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+        return nullptr;
+    }
+    auto item = std::move(ready_.front());
+    ready_.pop_front();
+    ready_bytes_ -= gather_bytes(*item);
+    lock.unlock();
+    space_cv_.notify_one();
+    return item;
+}
+
+void GatherStream::recycle(std::unique_ptr<StreamedGather> item) {
+    if (!item) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(std::move(item));
+}
@@ -0,0 +1,133 @@
+#include "sgylib/IndexCodec.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Серии короче этого выгоднее хранить литералами
+constexpr size_t MIN_RUN_LENGTH = 4;
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+void put_varint(uint64_t v, std::vector<char>& out) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+[[noreturn]] void corrupted() {
+    throw std::runtime_error("Corrupted trace index blob.");
+}
+
+inline uint64_t get_varint(const uint8_t*& p, const uint8_t* end) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) corrupted();
+        uint8_t byte = *p++;
+        v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return v;
+    }
+    corrupted();
+}
+
+} // namespace
+
+void encode_indices(std::span<const int> indices, std::vector<char>& out) {
+    const size_t n = indices.size();
+    put_varint(n, out);
+
+    auto delta = [&indices](size_t i) {
+        return static_cast<int64_t>(indices[i]) - (i == 0 ? 0 : static_cast<int64_t>(indices[i - 1]));
+    };
+    auto flush_literals = [&](size_t from, size_t to) {
+        if (from == to) return;
+        put_varint(static_cast<uint64_t>(to - from) << 1, out);
+        for (size_t i = from; i < to; ++i) put_varint(zigzag(delta(i)), out);
+    };
+
+    size_t literal_start = 0;
+    size_t i = 0;
+    while (i < n) {
+        const int64_t d = delta(i);
+        size_t j = i + 1;
+        while (j < n && delta(j) == d) ++j;
+        if (j - i >= MIN_RUN_LENGTH) {
+            flush_literals(literal_start, i);
+            put_varint((static_cast<uint64_t>(j - i) << 1) | 1, out);
+            put_varint(zigzag(d), out);
+            literal_start = j;
+        }
+        i = j;
+    }
+    flush_literals(literal_start, n);
+}
+
+void decode_indices(IndexEncoding encoding, const void* data, size_t size, uint64_t max_count, std::vector<int>& out) {
+    if (encoding == IndexEncoding::Raw) {
+        const size_t count = size / sizeof(int);
+        if (count > max_count) corrupted();
+        const size_t start = out.size();
+        out.resize(start + count);
+        if (count > 0) std::memcpy(out.data() + start, data, count * sizeof(int));
+        return;
+    }
+    if (encoding != IndexEncoding::DeltaVarint) {
+        throw std::runtime_error("Unknown trace index encoding: " + std::to_string(static_cast<int>(encoding)));
+    }
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* const end = p + size;
+    const uint64_t count = get_varint(p, end);
+    // Число индексов из BLOB не доверяем: несколько испорченных байт не должны
+    // приводить к выделению гигабайт до проверки содержимого
+    if (count > std::min<uint64_t>(max_count, std::numeric_limits<int>::max())) corrupted();
+
+    const size_t start = out.size();
+    out.resize(start + count);
+    int* dst = out.data() + start;
+    int* const dst_end = dst + count;
+    int64_t prev = 0;
+
+    while (dst < dst_end) {
+        const uint64_t tag = get_varint(p, end);
+        const uint64_t len = tag >> 1;
+        if (len == 0 || len > static_cast<uint64_t>(dst_end - dst)) corrupted();
+
+        if (tag & 1) {
+            // Серия с постоянным шагом: арифметическая прогрессия, цикл векторизуется
+            const int64_t d = unzigzag(get_varint(p, end));
+            for (uint64_t k = 0; k < len; ++k) {
+                dst[k] = static_cast<int>(prev + static_cast<int64_t>(k + 1) * d);
+            }
+            prev += static_cast<int64_t>(len) * d;
+            dst += len;
+            continue;
+        }
+
+        int* const literal_end = dst + len;
+        while (dst < literal_end) {
+            // Быстрый путь: восемь однобайтовых разностей подряд проверяются одним сравнением
+            if (literal_end - dst >= 8 && end - p >= 8) {
+                uint64_t word;
+                std::memcpy(&word, p, sizeof(word));
+                if ((word & 0x8080808080808080ull) == 0) {
+                    for (int k = 0; k < 8; ++k) {
+                        prev += unzigzag(p[k]);
+                        dst[k] = static_cast<int>(prev);
+                    }
+                    p += 8;
+                    dst += 8;
+                    continue;
+                }
+            }
+            prev += unzigzag(get_varint(p, end));
+            *dst++ = static_cast<int>(prev);
+        }
+    }
+}
@@ -0,0 +1,367 @@
+#include "sgylib/SampleConvert.hpp"
+#include "sgylib/SegyUtil.hpp"
+#include <bit>
+#include <immintrin.h>
+
+// Схема IBM -> IEEE (на каждую линию вектора):
+//   u = F * 2^-24 * 16^(e - 64) = F * 2^(4e - 280), F - 24-битная мантисса.
+//   F переводится в float точно, затем к полю экспоненты прибавляется 4e - 280.
+//   Переполнение дает бесконечность, а результат ниже нормализованного диапазона
+//   получается одним умножением на 2^-126, т.е. округляется ровно один раз,
+//   как при static_cast<float>(double) в скалярной версии.
+//
+// Схема IEEE -> IBM:
+//   |x| = m * 2^(p - 23), m - 24-битная мантисса с неявной единицей.
+//   Экспонента IBM равна 65 + floor(p / 4), дробь - m >> (3 - (p & 3)).
+//   Денормализованные числа предварительно умножаются на 2^64. Ноль проверяется
+//   сравнением float, чтобы при включенном DAZ денормализованные числа, как и в
+//   скалярной версии, давали 0.
+
+namespace {
+
+// --- Скалярная реализация ---
+
+void ibm_to_float_scalar(const uint8_t* src, float* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = ibm_to_float(get_u32_be(src + i * 4));
+    }
+}
+
+void float_to_ibm_scalar(const float* src, uint8_t* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        float val = src[i];
+        // Inf/NaN распознаются по битам экспоненты: с -ffast-math std::isfinite всегда true,
+        // а скалярная ieee_to_ibm на бесконечности зацикливается
+        const uint32_t bits = std::bit_cast<uint32_t>(val);
+        uint32_t ibm;
+        if (((bits >> 23) & 0xFF) != 0xFF) {
+            ibm = ieee_to_ibm(val);
+        } else {
+            ibm = (bits & 0x80000000u) | 0x7FFFFFFFu;
+        }
+        put_u32_be(dst + i * 4, ibm);
+    }
+}
+
+// --- SSE4.1 ---
+
+__attribute__((target("sse4.1")))
+inline __m128i bswap32_sse(__m128i v) {
+    const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    return _mm_shuffle_epi8(v, mask);
+}
+
+__attribute__((target("sse4.1")))
+void ibm_to_float_sse41(const uint8_t* src, float* dst, size_t n) {
+    const __m128i sign_mask = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i frac_mask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i exp_mask = _mm_set1_epi32(0x7F);
+    const __m128i bias = _mm_set1_epi32(280);
+    const __m128i denorm_bias = _mm_set1_epi32(126);
+    const __m128i inf = _mm_set1_epi32(0x7F800000);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i max_exp = _mm_set1_epi32(254);
+    const __m128 denorm_scale = _mm_castsi128_ps(_mm_set1_epi32(1 << 23)); // 2^-126
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i u = bswap32_sse(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4)));
+        __m128i sign = _mm_and_si128(u, sign_mask);
+        __m128i e = _mm_and_si128(_mm_srli_epi32(u, 24), exp_mask);
+        __m128i f = _mm_and_si128(u, frac_mask);
+
+        __m128i bits = _mm_castps_si128(_mm_cvtepi32_ps(f));
+        __m128i shift = _mm_sub_epi32(_mm_slli_epi32(e, 2), bias);
+        __m128i new_exp = _mm_add_epi32(_mm_srli_epi32(bits, 23), shift);
+
+        __m128i normal = _mm_add_epi32(bits, _mm_slli_epi32(shift, 23));
+        __m128i scaled = _mm_add_epi32(bits, _mm_slli_epi32(_mm_add_epi32(shift, denorm_bias), 23));
+        __m128i tiny = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(scaled), denorm_scale));
+
+        __m128i tiny_ok = _mm_cmpgt_epi32(_mm_add_epi32(new_exp, denorm_bias), zero);
+        __m128i res = _mm_and_si128(tiny_ok, tiny);
+        res = _mm_blendv_epi8(res, normal, _mm_cmpgt_epi32(new_exp, zero));
+        res = _mm_blendv_epi8(res, inf, _mm_cmpgt_epi32(new_exp, max_exp));
+        res = _mm_andnot_si128(_mm_cmplt_epi32(f, one), res);
+        res = _mm_or_si128(res, sign);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), res);
+    }
+    ibm_to_float_scalar(src + i * 4, dst + i, n - i);
+}
+
+__attribute__((target("sse4.1")))
+void float_to_ibm_sse41(const float* src, uint8_t* dst, size_t n) {
+    const __m128i sign_mask = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i abs_mask = _mm_set1_epi32(0x7FFFFFFF);
+    const __m128i mant_mask = _mm_set1_epi32(0x007FFFFF);
+    const __m128i hidden_bit = _mm_set1_epi32(0x00800000);
+    const __m128i three = _mm_set1_epi32(3);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i exp_inf = _mm_set1_epi32(255);
+    const __m128 denorm_scale = _mm_castsi128_ps(_mm_set1_epi32((127 + 64) << 23)); // 2^64
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i b = _mm_castps_si128(_mm_loadu_ps(src + i));
+        __m128i sign = _mm_and_si128(b, sign_mask);
+        __m128i a = _mm_and_si128(b, abs_mask);
+        __m128i eb = _mm_srli_epi32(a, 23);
+
+        __m128i is_den = _mm_cmpeq_epi32(eb, zero);
+        __m128i a_scaled = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(a), denorm_scale));
+        __m128i an = _mm_blendv_epi8(a, a_scaled, is_den);
+        __m128i p = _mm_sub_epi32(_mm_srli_epi32(an, 23), _mm_set1_epi32(127));
+        p = _mm_sub_epi32(p, _mm_and_si128(is_den, _mm_set1_epi32(64)));
+
+        __m128i m = _mm_or_si128(_mm_and_si128(an, mant_mask), hidden_bit);
+        // m >> (3 - (p & 3)) == (m * 2^(p & 3)) >> 3; 2^k получаем из поля экспоненты float
+        __m128i q = _mm_and_si128(p, three);
+        __m128i pow2 = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(q, _mm_set1_epi32(127)), 23)));
+        __m128i frac = _mm_srli_epi32(_mm_mullo_epi32(m, pow2), 3);
+        __m128i ibm_exp = _mm_add_epi32(_mm_srai_epi32(p, 2), _mm_set1_epi32(65));
+
+        __m128i res = _mm_or_si128(sign, _mm_or_si128(_mm_slli_epi32(ibm_exp, 24), frac));
+        res = _mm_blendv_epi8(res, _mm_or_si128(sign, abs_mask), _mm_cmpeq_epi32(eb, exp_inf));
+        res = _mm_andnot_si128(_mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_setzero_ps())), res);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), bswap32_sse(res));
+    }
+    float_to_ibm_scalar(src + i, dst + i * 4, n - i);
+}
+
+// --- AVX2 ---
+
+__attribute__((target("avx2")))
+inline __m256i bswap32_avx2(__m256i v) {
+    const __m256i mask = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                         12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    return _mm256_shuffle_epi8(v, mask);
+}
+
+__attribute__((target("avx2")))
+void ibm_to_float_avx2(const uint8_t* src, float* dst, size_t n) {
+    const __m256i sign_mask = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+    const __m256i frac_mask = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i exp_mask = _mm256_set1_epi32(0x7F);
+    const __m256i bias = _mm256_set1_epi32(280);
+    const __m256i denorm_bias = _mm256_set1_epi32(126);
+    const __m256i inf = _mm256_set1_epi32(0x7F800000);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i max_exp = _mm256_set1_epi32(254);
+    const __m256 denorm_scale = _mm256_castsi256_ps(_mm256_set1_epi32(1 << 23)); // 2^-126
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i u = bswap32_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4)));
+        __m256i sign = _mm256_and_si256(u, sign_mask);
+        __m256i e = _mm256_and_si256(_mm256_srli_epi32(u, 24), exp_mask);
+        __m256i f = _mm256_and_si256(u, frac_mask);
+
+        __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(f));
+        __m256i shift = _mm256_sub_epi32(_mm256_slli_epi32(e, 2), bias);
+        __m256i new_exp = _mm256_add_epi32(_mm256_srli_epi32(bits, 23), shift);
+
+        __m256i normal = _mm256_add_epi32(bits, _mm256_slli_epi32(shift, 23));
+        __m256i scaled = _mm256_add_epi32(bits, _mm256_slli_epi32(_mm256_add_epi32(shift, denorm_bias), 23));
+        __m256i tiny = _mm256_castps_si256(_mm256_mul_ps(_mm256_castsi256_ps(scaled), denorm_scale));
+
+        __m256i tiny_ok = _mm256_cmpgt_epi32(_mm256_add_epi32(new_exp, denorm_bias), zero);
+        __m256i res = _mm256_and_si256(tiny_ok, tiny);
+        res = _mm256_blendv_epi8(res, normal, _mm256_cmpgt_epi32(new_exp, zero));
+        res = _mm256_blendv_epi8(res, inf, _mm256_cmpgt_epi32(new_exp, max_exp));
+        res = _mm256_andnot_si256(_mm256_cmpgt_epi32(one, f), res);
+        res = _mm256_or_si256(res, sign);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), res);
+    }
+    ibm_to_float_sse41(src + i * 4, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void float_to_ibm_avx2(const float* src, uint8_t* dst, size_t n) {
+    const __m256i sign_mask = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+    const __m256i abs_mask = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i mant_mask = _mm256_set1_epi32(0x007FFFFF);
+    const __m256i hidden_bit = _mm256_set1_epi32(0x00800000);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i exp_inf = _mm256_set1_epi32(255);
+    const __m256 denorm_scale = _mm256_castsi256_ps(_mm256_set1_epi32((127 + 64) << 23)); // 2^64
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i b = _mm256_castps_si256(_mm256_loadu_ps(src + i));
+        __m256i sign = _mm256_and_si256(b, sign_mask);
+        __m256i a = _mm256_and_si256(b, abs_mask);
+        __m256i eb = _mm256_srli_epi32(a, 23);
+
+        __m256i is_den = _mm256_cmpeq_epi32(eb, zero);
+        __m256i a_scaled = _mm256_castps_si256(_mm256_mul_ps(_mm256_castsi256_ps(a), denorm_scale));
+        __m256i an = _mm256_blendv_epi8(a, a_scaled, is_den);
+        __m256i p = _mm256_sub_epi32(_mm256_srli_epi32(an, 23), _mm256_set1_epi32(127));
+        p = _mm256_sub_epi32(p, _mm256_and_si256(is_den, _mm256_set1_epi32(64)));
+
+        __m256i m = _mm256_or_si256(_mm256_and_si256(an, mant_mask), hidden_bit);
+        __m256i frac = _mm256_srlv_epi32(m, _mm256_sub_epi32(three, _mm256_and_si256(p, three)));
+        __m256i ibm_exp = _mm256_add_epi32(_mm256_srai_epi32(p, 2), _mm256_set1_epi32(65));
+
+        __m256i res = _mm256_or_si256(sign, _mm256_or_si256(_mm256_slli_epi32(ibm_exp, 24), frac));
+        res = _mm256_blendv_epi8(res, _mm256_or_si256(sign, abs_mask), _mm256_cmpeq_epi32(eb, exp_inf));
+        res = _mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_setzero_ps(), _CMP_EQ_OQ)), res);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), bswap32_avx2(res));
+    }
+    float_to_ibm_sse41(src + i, dst + i * 4, n - i);
+}
+
+// --- AVX-512 (F + BW) ---
+
+// GCC 12 выдает ложные предупреждения -Wmaybe-uninitialized внутри _mm512_undefined_*()
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i bswap32_avx512(__m512i v) {
+    const __m512i mask = _mm512_set4_epi32(0x0C0D0E0F, 0x08090A0B, 0x04050607, 0x00010203);
+    return _mm512_shuffle_epi8(v, mask);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void ibm_to_float_avx512(const uint8_t* src, float* dst, size_t n) {
+    const __m512i sign_mask = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+    const __m512i frac_mask = _mm512_set1_epi32(0x00FFFFFF);
+    const __m512i exp_mask = _mm512_set1_epi32(0x7F);
+    const __m512i bias = _mm512_set1_epi32(280);
+    const __m512i denorm_bias = _mm512_set1_epi32(126);
+    const __m512i inf = _mm512_set1_epi32(0x7F800000);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i max_exp = _mm512_set1_epi32(254);
+    const __m512 denorm_scale = _mm512_castsi512_ps(_mm512_set1_epi32(1 << 23)); // 2^-126
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i u = bswap32_avx512(_mm512_loadu_si512(src + i * 4));
+        __m512i sign = _mm512_and_si512(u, sign_mask);
+        __m512i e = _mm512_and_si512(_mm512_srli_epi32(u, 24), exp_mask);
+        __m512i f = _mm512_and_si512(u, frac_mask);
+
+        __m512i bits = _mm512_castps_si512(_mm512_cvtepi32_ps(f));
+        __m512i shift = _mm512_sub_epi32(_mm512_slli_epi32(e, 2), bias);
+        __m512i new_exp = _mm512_add_epi32(_mm512_srli_epi32(bits, 23), shift);
+
+        __m512i normal = _mm512_add_epi32(bits, _mm512_slli_epi32(shift, 23));
+        __m512i scaled = _mm512_add_epi32(bits, _mm512_slli_epi32(_mm512_add_epi32(shift, denorm_bias), 23));
+        __m512i tiny = _mm512_castps_si512(_mm512_mul_ps(_mm512_castsi512_ps(scaled), denorm_scale));
+
+        __mmask16 tiny_ok = _mm512_cmpgt_epi32_mask(_mm512_add_epi32(new_exp, denorm_bias), zero);
+        __m512i res = _mm512_maskz_mov_epi32(tiny_ok, tiny);
+        res = _mm512_mask_mov_epi32(res, _mm512_cmpgt_epi32_mask(new_exp, zero), normal);
+        res = _mm512_mask_mov_epi32(res, _mm512_cmpgt_epi32_mask(new_exp, max_exp), inf);
+        res = _mm512_maskz_mov_epi32(_mm512_test_epi32_mask(f, f), res);
+        res = _mm512_or_si512(res, sign);
+
+        _mm512_storeu_si512(dst + i, res);
+    }
+    ibm_to_float_avx2(src + i * 4, dst + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void float_to_ibm_avx512(const float* src, uint8_t* dst, size_t n) {
+    const __m512i sign_mask = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+    const __m512i abs_mask = _mm512_set1_epi32(0x7FFFFFFF);
+    const __m512i mant_mask = _mm512_set1_epi32(0x007FFFFF);
+    const __m512i hidden_bit = _mm512_set1_epi32(0x00800000);
+    const __m512i three = _mm512_set1_epi32(3);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i exp_inf = _mm512_set1_epi32(255);
+    const __m512 denorm_scale = _mm512_castsi512_ps(_mm512_set1_epi32((127 + 64) << 23)); // 2^64
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i b = _mm512_castps_si512(_mm512_loadu_ps(src + i));
+        __m512i sign = _mm512_and_si512(b, sign_mask);
+        __m512i a = _mm512_and_si512(b, abs_mask);
+        __m512i eb = _mm512_srli_epi32(a, 23);
+
+        __mmask16 is_den = _mm512_cmpeq_epi32_mask(eb, zero);
+        __m512i a_scaled = _mm512_castps_si512(_mm512_mul_ps(_mm512_castsi512_ps(a), denorm_scale));
+        __m512i an = _mm512_mask_mov_epi32(a, is_den, a_scaled);
+        __m512i p = _mm512_sub_epi32(_mm512_srli_epi32(an, 23), _mm512_set1_epi32(127));
+        p = _mm512_mask_sub_epi32(p, is_den, p, _mm512_set1_epi32(64));
+
+        __m512i m = _mm512_or_si512(_mm512_and_si512(an, mant_mask), hidden_bit);
+        __m512i frac = _mm512_srlv_epi32(m, _mm512_sub_epi32(three, _mm512_and_si512(p, three)));
+        __m512i ibm_exp = _mm512_add_epi32(_mm512_srai_epi32(p, 2), _mm512_set1_epi32(65));
+
+        __m512i res = _mm512_or_si512(sign, _mm512_or_si512(_mm512_slli_epi32(ibm_exp, 24), frac));
+        res = _mm512_mask_mov_epi32(res, _mm512_cmpeq_epi32_mask(eb, exp_inf), _mm512_or_si512(sign, abs_mask));
+        res = _mm512_maskz_mov_epi32(_mm512_cmp_ps_mask(_mm512_castsi512_ps(a), _mm512_setzero_ps(), _CMP_NEQ_UQ), res);
+
+        _mm512_storeu_si512(dst + i * 4, bswap32_avx512(res));
+    }
+    float_to_ibm_avx2(src + i, dst + i * 4, n - i);
+}
+
+#pragma GCC diagnostic pop
+
+// --- Выбор реализации ---
+
+struct ConvertKernels {
+    void (*to_float)(const uint8_t*, float*, size_t);
+    void (*to_ibm)(const float*, uint8_t*, size_t);
+    const char* name;
+};
+
+constexpr ConvertKernels KERNEL_AVX512 = {ibm_to_float_avx512, float_to_ibm_avx512, "avx512"};
+constexpr ConvertKernels KERNEL_AVX2 = {ibm_to_float_avx2, float_to_ibm_avx2, "avx2"};
+constexpr ConvertKernels KERNEL_SSE41 = {ibm_to_float_sse41, float_to_ibm_sse41, "sse4.1"};
+constexpr ConvertKernels KERNEL_SCALAR = {ibm_to_float_scalar, float_to_ibm_scalar, "scalar"};
+
+bool kernel_supported(const ConvertKernels& k) {
+    if (&k == &KERNEL_AVX512) {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+    if (&k == &KERNEL_AVX2) return __builtin_cpu_supports("avx2");
+    if (&k == &KERNEL_SSE41) return __builtin_cpu_supports("sse4.1");
+    return true;
+}
+
+const ConvertKernels* detect_kernels() {
+    for (const ConvertKernels* k : {&KERNEL_AVX512, &KERNEL_AVX2, &KERNEL_SSE41}) {
+        if (kernel_supported(*k)) return k;
+    }
+    return &KERNEL_SCALAR;
+}
+
+const ConvertKernels*& active_kernels() {
+    static const ConvertKernels* kernels = detect_kernels();
+    return kernels;
+}
+
+} // namespace
+
+void ibm_to_float_block(const uint8_t* src, float* dst, size_t n) {
+    active_kernels()->to_float(src, dst, n);
+}
+
+void float_to_ibm_block(const float* src, uint8_t* dst, size_t n) {
+    active_kernels()->to_ibm(src, dst, n);
+}
+
+const char* sample_convert_kernel() {
+    return active_kernels()->name;
+}
+
+bool set_sample_convert_kernel(const std::string& name) {
+    for (const ConvertKernels* k : {&KERNEL_AVX512, &KERNEL_AVX2, &KERNEL_SSE41, &KERNEL_SCALAR}) {
+        if (name == k->name) {
+            if (!kernel_supported(*k)) return false;
+            active_kernels() = k;
+            return true;
+        }
+    }
+    return false;
+}
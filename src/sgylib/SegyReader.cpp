@@ -4,29 +4,55 @@
 #include "sgylib/TraceFieldMap.hpp"
 #include <algorithm>
 #include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <exception>
+#include <filesystem>
+
+// POSIX: позиционное чтение и отображение файла в память
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Основной конструктор, инициализирует чтение SEG-Y файла
-SegyReader::SegyReader(const std::string& filename, const std::string& mode)
-    : filename_(filename), mode_(mode) {
-    std::ios_base::openmode openmode = std::ios::binary;
+SegyReader::SegyReader(const std::string& filename, const std::string& mode, IoBackend backend)
+    : filename_(filename), mode_(mode), backend_(backend) {
+    int flags = 0;
     if (mode == "r") {
-        openmode |= std::ios::in;
+        flags = O_RDONLY;
     } else if (mode == "r+") {
-        openmode |= std::ios::in | std::ios::out;
+        flags = O_RDWR;
     } else {
         throw std::invalid_argument("Unknown mode for SegyReader: " + mode);
     }
 
-    file_.open(filename, openmode);
-    if (!file_) {
+    fd_ = ::open(filename.c_str(), flags | O_CLOEXEC);
+    if (fd_ < 0) {
         throw std::runtime_error("Cannot open SEG-Y file: " + filename);
     }
 
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("Cannot stat SEG-Y file: " + filename);
+    }
+    std::streamoff file_size = st.st_size;
+
+    if (file_size < data_offset()) {
+        ::close(fd_);
+        throw std::runtime_error("File is too small to be a SEG-Y file: " + filename);
+    }
+
+    if (backend_ == IoBackend::Mmap) {
+        map_file(static_cast<size_t>(file_size));
+    }
+
     text_header_.resize(3200);
-    file_.read(text_header_.data(), 3200);
+    read_at(0, 3200, text_header_.data());
 
     bin_header_.resize(400);
-    file_.read(reinterpret_cast<char*>(bin_header_.data()), 400);
+    read_at(3200, 400, reinterpret_cast<char*>(bin_header_.data()));
 
     num_samples_ = get_bin_field_value(bin_header_.data(), "SamplesPerTrace");
     sample_interval_ = get_bin_field_value(bin_header_.data(), "SampleInterval");
@@ -36,25 +62,62 @@ SegyReader::SegyReader(const std::string& filename, const std::string& mode)
         throw std::runtime_error("Invalid number of samples per trace in binary header: " + std::to_string(num_samples_));
     }
 
-    file_.seekg(0, std::ios::end);
-    std::streamoff file_size = file_.tellg();
-    trace_bsize_ = 240 + num_samples_ * 4;
-    num_traces_ = (file_size - data_offset()) / trace_bsize_;
+    sample_format_ = sample_format_from_code(get_bin_field_value(bin_header_.data(), "DataSampleFormat"));
+    decode_ = get_sample_decoder(sample_format_);
 
-    file_.seekg(data_offset(), std::ios::beg);
+    trace_bsize_ = 240 + num_samples_ * sample_size(sample_format_);
+    num_traces_ = (file_size - data_offset()) / trace_bsize_;
 }
 
 SegyReader::~SegyReader() {
-    if (file_.is_open()) {
-        file_.close();
+    if (map_) {
+        munmap(const_cast<uint8_t*>(map_), map_size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void SegyReader::map_file(size_t file_size) {
+    void* ptr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (ptr == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("Cannot map SEG-Y file into memory: " + filename_);
+    }
+    map_ = static_cast<const uint8_t*>(ptr);
+    map_size_ = file_size;
+}
+
+void SegyReader::read_at(std::streamoff offset, size_t bytes, char* buffer) const {
+    if (map_) {
+        if (offset < 0 || static_cast<size_t>(offset) + bytes > map_size_) {
+            throw std::out_of_range("Read beyond the end of SEG-Y file: " + filename_);
+        }
+        std::memcpy(buffer, map_ + offset, bytes);
+        return;
+    }
+    // pread не меняет позицию дескриптора, поэтому вызовы из разных потоков не мешают друг другу
+    while (bytes > 0) {
+        ssize_t n = ::pread(fd_, buffer, bytes, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Read error in SEG-Y file " + filename_ + ": " + std::strerror(errno));
+        }
+        if (n == 0) {
+            throw std::out_of_range("Read beyond the end of SEG-Y file: " + filename_);
+        }
+        buffer += n;
+        offset += n;
+        bytes -= static_cast<size_t>(n);
     }
 }
 
 // --- Реализация новых методов управления TraceMap ---
 
-void SegyReader::build_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys) {
+void SegyReader::build_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys,
+                                TraceMapBackend backend) {
     // Создаем объект TraceMap в динамической памяти и оборачиваем в shared_ptr
-    auto map_ptr = std::make_shared<TraceMap>(db_path, keys);
+    auto map_ptr = std::make_shared<TraceMap>(db_path, keys, backend);
     
     // Вызываем его метод для построения (это долгая, параллельная операция)
     map_ptr->build_map(*this);
@@ -63,14 +126,41 @@ void SegyReader::build_tracemap(const std::string& map_name, const std::string&
     tracemaps_[map_name] = map_ptr;
 }
 
-void SegyReader::load_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys) {
+void SegyReader::load_tracemap(const std::string& map_name, const std::string& db_path, const std::vector<std::string>& keys,
+                               TraceMapBackend backend) {
+    if (backend == TraceMapBackend::Binary && !std::filesystem::exists(db_path)) {
+        throw std::runtime_error("Trace index file not found: " + db_path);
+    }
     // Создаем объект, который откроет существующий файл БД, но не будет его перестраивать
-    auto map_ptr = std::make_shared<TraceMap>(db_path, keys);
+    auto map_ptr = std::make_shared<TraceMap>(db_path, keys, backend);
     
     // Сохраняем указатель
     tracemaps_[map_name] = map_ptr;
 }
 
+void SegyReader::build_tracemaps(const std::vector<TraceMapSpec>& specs) {
+    std::vector<std::shared_ptr<TraceMap>> maps;
+    std::vector<TraceMap*> targets;
+    for (const auto& spec : specs) {
+        maps.push_back(std::make_shared<TraceMap>(spec.db_path, spec.keys, spec.backend));
+        targets.push_back(maps.back().get());
+    }
+
+    TraceMap::build_maps(*this, targets);
+
+    for (size_t i = 0; i < specs.size(); ++i) {
+        tracemaps_[specs[i].name] = maps[i];
+    }
+}
+
+TraceMapUpdate SegyReader::update_tracemap(const std::string& map_name, const std::string& db_path,
+                                           const std::vector<std::string>& keys, TraceMapBackend backend) {
+    auto map_ptr = std::make_shared<TraceMap>(db_path, keys, backend);
+    TraceMapUpdate result = map_ptr->update_map(*this);
+    tracemaps_[map_name] = map_ptr;
+    return result;
+}
+
 std::shared_ptr<TraceMap> SegyReader::get_tracemap(const std::string& name) const {
     auto it = tracemaps_.find(name);
     if (it == tracemaps_.end()) {
@@ -83,25 +173,23 @@ std::shared_ptr<TraceMap> SegyReader::get_tracemap(const std::string& name) cons
 
 std::vector<float> SegyReader::get_trace(int index) const {
     std::vector<float> trace_data(num_samples_);
+    if (map_) {
+        decode_trace(get_trace_view(index), trace_data.data());
+        return trace_data;
+    }
     std::streamoff offset = trace_data_offset(index);
     
     // В буфер читаем только данные трассы
-    std::vector<uint8_t> buf(num_samples_ * 4);
-    file_.seekg(offset, std::ios::beg);
-    file_.read(reinterpret_cast<char*>(buf.data()), buf.size());
+    std::vector<uint8_t> buf(trace_bsize_ - 240);
+    read_at(offset, buf.size(), reinterpret_cast<char*>(buf.data()));
 
-    for (int i = 0; i < num_samples_; ++i) {
-        uint32_t ibm = get_u32_be(&buf[i * 4]);
-        trace_data[i] = ibm_to_float(ibm);
-    }
+    decode_(buf.data(), trace_data.data(), num_samples_);
     return trace_data;
 }
 
 std::vector<uint8_t> SegyReader::get_trace_header(int index) const {
     std::vector<uint8_t> header(240);
-    std::streamoff offset = trace_offset(index);
-    file_.seekg(offset, std::ios::beg);
-    file_.read(reinterpret_cast<char*>(header.data()), 240);
+    read_at(trace_offset(index), 240, reinterpret_cast<char*>(header.data()));
     return header;
 }
 
@@ -137,32 +225,213 @@ void SegyReader::get_gather_and_headers(const std::string& tracemap_name,
     read_gather_block(indices, headers, traces);
 }
 
+template <typename Fn>
+void SegyReader::for_each_trace(const std::vector<int>& indices, Fn&& fn) const {
+    // Индексы отсортированы: соседние и почти соседние трассы читаются одним
+    // блоком. Разрыв до read_gap_tolerance_ трасс дешевле лишнего системного вызова.
+    // При отображении в память блоки не нужны: читаем прямо из файла.
+    std::vector<uint8_t> buf;
+    size_t run_start = 0;
+    while (run_start < indices.size()) {
+        size_t run_end = run_start + 1;
+        if (!map_) {
+            while (run_end < indices.size()) {
+                int gap = indices[run_end] - indices[run_end - 1] - 1;
+                size_t run_bytes = static_cast<size_t>(indices[run_end] - indices[run_start] + 1) * trace_bsize_;
+                if (gap < 0 || gap > read_gap_tolerance_ || run_bytes > MAX_COALESCED_READ_BYTES) break;
+                ++run_end;
+            }
+        }
+
+        int first = indices[run_start];
+        const uint8_t* base;
+        if (map_) {
+            base = get_trace_view(first).header;
+        } else {
+            size_t run_bytes = static_cast<size_t>(indices[run_end - 1] - first + 1) * trace_bsize_;
+            buf.resize(run_bytes);
+            read_at(trace_offset(first), run_bytes, reinterpret_cast<char*>(buf.data()));
+            base = buf.data();
+        }
+
+        for (size_t i = run_start; i < run_end; ++i) {
+            fn(i, base + static_cast<size_t>(indices[i] - first) * trace_bsize_);
+        }
+        run_start = run_end;
+    }
+}
+
 void SegyReader::read_gather_block(const std::vector<int>& indices,
                                    std::vector<std::vector<uint8_t>>& headers,
                                    std::vector<std::vector<float>>& traces) const {
     headers.resize(indices.size());
     traces.resize(indices.size());
 
-    for (size_t i = 0; i < indices.size(); ++i) {
-        int idx = indices[i];
-        std::streamoff offset = trace_offset(idx);
-        file_.seekg(offset, std::ios::beg);
-
-        std::vector<uint8_t> buf(trace_bsize_);
-        file_.read(reinterpret_cast<char*>(buf.data()), trace_bsize_);
-        
+    for_each_trace(indices, [&](size_t i, const uint8_t* src) {
         // Копируем заголовок
-        headers[i].assign(buf.begin(), buf.begin() + 240);
+        headers[i].assign(src, src + 240);
 
         // Конвертируем данные трассы
         traces[i].resize(num_samples_);
-        for (int j = 0; j < num_samples_; ++j) {
-            uint32_t ibm = get_u32_be(&buf[240 + j * 4]);
-            traces[i][j] = ibm_to_float(ibm);
+        decode_(src + 240, traces[i].data(), num_samples_);
+    });
+}
+
+void SegyReader::read_gather(const std::string& tracemap_name,
+                             const std::vector<std::optional<int>>& keys,
+                             Gather& gather) const {
+    read_gather(get_tracemap(tracemap_name)->find_trace_indices(keys), gather);
+}
+
+void SegyReader::read_gather(std::vector<int> indices, Gather& gather) const {
+    std::sort(indices.begin(), indices.end());
+
+    gather.resize(static_cast<int>(indices.size()), num_samples_);
+    for_each_trace(indices, [&](size_t i, const uint8_t* src) {
+        std::memcpy(gather.header(static_cast<int>(i)), src, Gather::HEADER_SIZE);
+        decode_(src + 240, gather.trace(static_cast<int>(i)), num_samples_);
+    });
+}
+
+GatherStream SegyReader::stream_gathers(std::unique_ptr<TraceMapCursor> cursor, GatherStreamOptions options) const {
+    // std::function требует копируемого функтора
+    std::shared_ptr<TraceMapCursor> shared_cursor = std::move(cursor);
+    return GatherStream(*this, [shared_cursor](std::vector<int>& key, std::vector<int>& indices) {
+        return shared_cursor->next(key, indices);
+    }, options);
+}
+
+GatherStream SegyReader::stream_gathers(const std::string& tracemap_name,
+                                        std::vector<std::vector<std::optional<int>>> key_sequence,
+                                        GatherStreamOptions options) const {
+    auto tracemap = get_tracemap(tracemap_name);
+    auto keys = std::make_shared<std::vector<std::vector<std::optional<int>>>>(std::move(key_sequence));
+    auto position = std::make_shared<size_t>(0);
+    return GatherStream(*this, [tracemap, keys, position](std::vector<int>& key, std::vector<int>& indices) {
+        if (*position == keys->size()) return false;
+        const auto& values = (*keys)[(*position)++];
+        for (const auto& v : values) {
+            if (v) key.push_back(*v);
         }
+        indices = tracemap->find_trace_indices(values);
+        return true;
+    }, options);
+}
+
+void SegyReader::set_read_gap_tolerance(int traces) {
+    if (traces < 0) {
+        throw std::invalid_argument("Read gap tolerance must be non-negative: " + std::to_string(traces));
+    }
+    read_gap_tolerance_ = traces;
+}
+
+// --- Доступ без копирования ---
+
+TraceView SegyReader::get_trace_view(int index) const {
+    if (!map_) {
+        throw std::logic_error("Trace views require IoBackend::Mmap: " + filename_);
+    }
+    if (index < 0 || index >= num_traces_) {
+        throw std::out_of_range("Trace index out of range: " + std::to_string(index));
+    }
+    const uint8_t* header = map_ + trace_offset(index);
+    return {header, header + 240};
+}
+
+std::vector<TraceView> SegyReader::get_gather_views(const std::string& tracemap_name,
+                                                    const std::vector<std::optional<int>>& keys) const {
+    auto indices = get_tracemap(tracemap_name)->find_trace_indices(keys);
+    std::sort(indices.begin(), indices.end());
+
+    std::vector<TraceView> views;
+    views.reserve(indices.size());
+    for (int idx : indices) {
+        views.push_back(get_trace_view(idx));
+    }
+    return views;
+}
+
+void SegyReader::decode_trace(const TraceView& view, float* out) const {
+    decode_(view.samples, out, num_samples_);
+}
+
+void SegyReader::advise(AccessPattern pattern) const {
+    advise_traces(0, num_traces_, pattern);
+    if (map_) {
+        // Текстовый и бинарный заголовки читаются постоянно, держим их в памяти
+        madvise(const_cast<uint8_t*>(map_), static_cast<size_t>(data_offset()), MADV_WILLNEED);
     }
 }
 
+void SegyReader::advise_traces(int start_trace, int count, AccessPattern pattern) const {
+    if (count <= 0) return;
+
+    size_t begin = static_cast<size_t>(trace_offset(start_trace));
+    size_t end = static_cast<size_t>(trace_offset(start_trace + count));
+
+    if (!map_) {
+        int advice = POSIX_FADV_NORMAL;
+        switch (pattern) {
+            case AccessPattern::Normal:     advice = POSIX_FADV_NORMAL; break;
+            case AccessPattern::Sequential: advice = POSIX_FADV_SEQUENTIAL; break;
+            case AccessPattern::Random:     advice = POSIX_FADV_RANDOM; break;
+            case AccessPattern::WillNeed:   advice = POSIX_FADV_WILLNEED; break;
+        }
+        posix_fadvise(fd_, static_cast<off_t>(begin), static_cast<off_t>(end - begin), advice);
+        return;
+    }
+
+    int advice = MADV_NORMAL;
+    switch (pattern) {
+        case AccessPattern::Normal:     advice = MADV_NORMAL; break;
+        case AccessPattern::Sequential: advice = MADV_SEQUENTIAL; break;
+        case AccessPattern::Random:     advice = MADV_RANDOM; break;
+        case AccessPattern::WillNeed:   advice = MADV_WILLNEED; break;
+    }
+
+    // madvise требует адрес, выровненный по границе страницы
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    end = std::min(map_size_, end);
+    if (begin >= end) return;
+    begin -= begin % page;
+    madvise(const_cast<uint8_t*>(map_) + begin, end - begin, advice);
+}
+
+SourceFingerprint SegyReader::fingerprint(int indexed_traces) const {
+    if (indexed_traces < 0 || indexed_traces > num_traces_) {
+        throw std::out_of_range("Fingerprint trace count out of range: " + std::to_string(indexed_traces));
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        throw std::runtime_error("Cannot stat SEG-Y file: " + filename_);
+    }
+
+    SourceFingerprint fp;
+    fp.file_size = static_cast<uint64_t>(st.st_size);
+    fp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    fp.num_traces = indexed_traces;
+    fp.trace_size = trace_bsize_;
+
+    // FNV-1a по текстовому заголовку и заголовкам первой и последней трасс
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(reinterpret_cast<const uint8_t*>(text_header_.data()), text_header_.size());
+    if (indexed_traces > 0) {
+        uint8_t header[240];
+        read_headers(0, 1, header);
+        mix(header, sizeof(header));
+        read_headers(indexed_traces - 1, 1, header);
+        mix(header, sizeof(header));
+    }
+    fp.header_checksum = hash;
+    return fp;
+}
+
 // --- Реализация геттеров и вспомогательных методов ---
 
 int SegyReader::num_traces() const { return num_traces_; }
@@ -199,7 +468,53 @@ int16_t SegyReader::get_bin_header_value_i16(const std::string& key) const {
 }
 
 void SegyReader::read_raw_block(int start_trace_idx, size_t bytes_to_read, char* buffer) const {
-    std::streamoff offset = trace_offset(start_trace_idx);
-    file_.seekg(offset, std::ios::beg);
-    file_.read(buffer, bytes_to_read);
+    read_at(trace_offset(start_trace_idx), bytes_to_read, buffer);
+}
+
+void SegyReader::read_headers(int start_trace, int count, uint8_t* buffer) const {
+    if (count <= 0) return;
+    if (start_trace < 0 || start_trace + count > num_traces_) {
+        throw std::out_of_range("Header range out of bounds: " + std::to_string(start_trace) + "+" + std::to_string(count));
+    }
+
+    if (!header_scan_is_strided()) {
+        // Короткие трассы: последовательное чтение блоками выгоднее отдельных запросов
+        const int traces_per_block = std::max<int>(1, HEADER_SCAN_BLOCK_BYTES / trace_bsize_);
+        std::vector<uint8_t> block(map_ ? 0 : static_cast<size_t>(traces_per_block) * trace_bsize_);
+        for (int done = 0; done < count; done += traces_per_block) {
+            int n = std::min(traces_per_block, count - done);
+            const uint8_t* src;
+            if (map_) {
+                src = map_ + trace_offset(start_trace + done);
+            } else {
+                read_at(trace_offset(start_trace + done), static_cast<size_t>(n) * trace_bsize_,
+                        reinterpret_cast<char*>(block.data()));
+                src = block.data();
+            }
+            for (int i = 0; i < n; ++i) {
+                std::memcpy(buffer + static_cast<size_t>(done + i) * 240, src + static_cast<size_t>(i) * trace_bsize_, 240);
+            }
+        }
+        return;
+    }
+
+    // Длинные трассы: каждый заголовок читается отдельно. Запросы идут из нескольких
+    // потоков, чтобы держать очередь устройства заполненной. Исключения из параллельной
+    // области переносятся в вызывающий поток.
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < count; ++i) {
+        try {
+            uint8_t* dst = buffer + static_cast<size_t>(i) * 240;
+            if (map_) {
+                std::memcpy(dst, map_ + trace_offset(start_trace + i), 240);
+            } else {
+                read_at(trace_offset(start_trace + i), 240, reinterpret_cast<char*>(dst));
+            }
+        } catch (...) {
+            #pragma omp critical(segy_read_headers_error)
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
 }
\ No newline at end of file
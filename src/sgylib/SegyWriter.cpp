@@ -3,11 +3,17 @@
 #include "sgylib/BinFieldMap.hpp" // Для доступа к смещениям в бинарном заголовке
 #include <stdexcept>
 #include <vector>
+#include <cstring>
 
 // --- Приватный метод для инициализации ---
 void SegyWriter::init() {
     this->num_traces_ = 0;
-    this->trace_bsize_ = 240 + this->num_samples_ * 4;
+    this->encode_ = get_sample_encoder(sample_format_);
+    this->trace_bsize_ = 240 + this->num_samples_ * sample_size(sample_format_);
+
+    // Формат отсчетов в бинарном заголовке должен соответствовать записываемым данным
+    set_i16_be(bin_header_.data(), BinFieldOffsets.at("DataSampleFormat").offset,
+               static_cast<int16_t>(sample_format_));
     
     file_.open(filename_, std::ios::binary | std::ios::out | std::ios::trunc);
     if (!file_) {
@@ -21,12 +27,13 @@ void SegyWriter::init() {
 
 // --- Конструкторы ---
 
-SegyWriter::SegyWriter(const std::string& filename, const SegyReader& reader)
+SegyWriter::SegyWriter(const std::string& filename, const SegyReader& reader, SampleFormat format)
     : filename_(filename),
       text_header_(reader.text_header()),
       bin_header_(reader.bin_header()),
       num_samples_(reader.num_samples()),
-      sample_interval_(reader.sample_interval())
+      sample_interval_(reader.sample_interval()),
+      sample_format_(format)
 {
     init();
 }
@@ -35,12 +42,14 @@ SegyWriter::SegyWriter(const std::string& filename,
                        const std::vector<char>& text_header,
                        const std::vector<uint8_t>& bin_header,
                        int num_samples,
-                       float sample_interval)
+                       float sample_interval,
+                       SampleFormat format)
     : filename_(filename),
       text_header_(text_header),
       bin_header_(bin_header),
       num_samples_(num_samples),
-      sample_interval_(sample_interval)
+      sample_interval_(sample_interval),
+      sample_format_(format)
 {
     if (text_header.size() != 3200) throw std::invalid_argument("Text header must be 3200 bytes.");
     if (bin_header.size() != 400) throw std::invalid_argument("Binary header must be 400 bytes.");
@@ -82,17 +91,15 @@ void SegyWriter::write_trace(const std::vector<uint8_t>& header, const std::vect
         throw std::invalid_argument("Trace samples size mismatch.");
     }
 
-    // Записываем заголовок
-    file_.write(reinterpret_cast<const char*>(header.data()), 240);
-    
-    // Конвертируем и записываем отсчеты, используя утилиты
-    std::vector<uint8_t> sample_bytes(samples.size() * 4);
-    for (size_t i = 0; i < samples.size(); ++i) {
-        uint32_t ibm = ieee_to_ibm(samples[i]);
-        // ИСПОЛЬЗУЕМ НОВУЮ УТИЛИТУ
-        put_u32_be(&sample_bytes[i * 4], ibm);
-    }
-    file_.write(reinterpret_cast<const char*>(sample_bytes.data()), sample_bytes.size());
+    write_trace(header.data(), samples.data());
+}
+
+void SegyWriter::write_trace(const uint8_t* header, const float* samples) {
+    // Заголовок и отсчеты собираются в один буфер и записываются одним вызовом
+    buffer_.resize(trace_bsize_);
+    std::memcpy(buffer_.data(), header, 240);
+    encode_(samples, buffer_.data() + 240, num_samples_);
+    file_.write(reinterpret_cast<const char*>(buffer_.data()), trace_bsize_);
 
     num_traces_++;
 }
@@ -123,12 +130,8 @@ void SegyWriter::write_gather(const std::vector<std::vector<uint8_t>>& headers,
         
         // Конвертируем и добавляем отсчеты в буфер
         size_t current_size = gather_buffer.size();
-        gather_buffer.resize(current_size + trace_samples.size() * 4);
-        for (size_t j = 0; j < trace_samples.size(); ++j) {
-            uint32_t ibm = ieee_to_ibm(trace_samples[j]);
-            // ИСПОЛЬЗУЕМ НОВУЮ УТИЛИТУ
-            put_u32_be(&gather_buffer[current_size + j * 4], ibm);
-        }
+        gather_buffer.resize(current_size + trace_bsize_ - 240);
+        encode_(trace_samples.data(), &gather_buffer[current_size], trace_samples.size());
     }
 
     // Записываем весь буфер за один системный вызов
@@ -137,6 +140,26 @@ void SegyWriter::write_gather(const std::vector<std::vector<uint8_t>>& headers,
     num_traces_ += headers.size();
 }
 
+void SegyWriter::write_gather(const Gather& gather) {
+    if (gather.empty()) {
+        return; // Нечего записывать
+    }
+    if (gather.num_samples() != num_samples_) {
+        throw std::invalid_argument("Gather samples size mismatch.");
+    }
+
+    // Весь сейсмосбор кодируется в переиспользуемый буфер и пишется за один вызов
+    buffer_.resize(static_cast<size_t>(gather.num_traces()) * trace_bsize_);
+    for (int i = 0; i < gather.num_traces(); ++i) {
+        uint8_t* dst = buffer_.data() + static_cast<size_t>(i) * trace_bsize_;
+        std::memcpy(dst, gather.header(i), 240);
+        encode_(gather.trace(i), dst + 240, num_samples_);
+    }
+    file_.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size());
+
+    num_traces_ += gather.num_traces();
+}
+
 // УДАЛЕНО: write_gather_block и write_trace_internal.
 // Их функциональность теперь чисто и эффективно реализована в write_gather и write_trace.
 // Если вам все еще нужен write_gather_block, он должен просто вызывать write_gather.
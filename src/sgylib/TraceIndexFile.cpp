@@ -0,0 +1,288 @@
+#include "sgylib/TraceIndexFile.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+// POSIX: отображение файла в память
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'S', 'G', 'Y', 'T', 'I', 'D', 'X', '\0'};
+// Версия 2 добавила в заголовок отпечаток исходного файла; файлы версии 1 читаются без него
+constexpr uint32_t INDEX_VERSION = 2;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_keys;
+    uint64_t num_tuples;
+    uint64_t num_indices;
+    uint64_t keys_offset;
+    uint64_t keys_size;
+    uint64_t tuples_offset;
+    uint64_t offsets_offset;
+    uint64_t indices_offset;
+    uint64_t file_size;
+    // Версия 2
+    uint64_t source_file_size;
+    int64_t source_mtime_ns;
+    int64_t source_num_traces;
+    int64_t source_trace_size;
+    uint64_t source_header_checksum;
+};
+
+// Размер заголовка версии 1 (без отпечатка)
+constexpr size_t INDEX_HEADER_V1_SIZE = offsetof(IndexHeader, source_file_size);
+
+// Секции выравниваются по 8 байт, чтобы массивы в отображении были выровнены
+uint64_t align8(uint64_t v) { return (v + 7) & ~uint64_t(7); }
+
+// Лексикографическое сравнение первых n ключей
+int compare_prefix(const int32_t* a, const int32_t* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+TraceIndexFile::TraceIndexFile(const std::string& path, const std::vector<std::string>& keys)
+    : path_(path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open trace index: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < INDEX_HEADER_V1_SIZE) {
+        ::close(fd);
+        throw std::runtime_error("Trace index is truncated: " + path);
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    void* ptr = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map trace index into memory: " + path);
+    }
+    map_ = static_cast<const uint8_t*>(ptr);
+
+    IndexHeader header{};
+    std::memcpy(&header, map_, std::min(sizeof(header), map_size_));
+    try {
+        if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+            throw std::runtime_error("Not a trace index file: " + path);
+        }
+        if (header.version != 1 && header.version != INDEX_VERSION) {
+            throw std::runtime_error("Unsupported trace index version " + std::to_string(header.version) + ": " + path);
+        }
+        if (header.file_size != map_size_ ||
+            header.indices_offset + header.num_indices * sizeof(int32_t) > map_size_) {
+            throw std::runtime_error("Trace index is truncated: " + path);
+        }
+
+        // Ключи в файле должны совпадать с запрошенными
+        std::vector<std::string> stored_keys;
+        const char* names = reinterpret_cast<const char*>(map_ + header.keys_offset);
+        const char* names_end = names + header.keys_size;
+        while (names < names_end) {
+            stored_keys.emplace_back(names);
+            names += stored_keys.back().size() + 1;
+        }
+        if (stored_keys != keys) {
+            throw std::invalid_argument("Trace index keys do not match the requested keys: " + path);
+        }
+    } catch (...) {
+        munmap(const_cast<uint8_t*>(map_), map_size_);
+        throw;
+    }
+
+    num_keys_ = header.num_keys;
+    num_tuples_ = header.num_tuples;
+    num_indices_ = header.num_indices;
+    tuples_ = reinterpret_cast<const int32_t*>(map_ + header.tuples_offset);
+    offsets_ = reinterpret_cast<const uint64_t*>(map_ + header.offsets_offset);
+    indices_ = reinterpret_cast<const int32_t*>(map_ + header.indices_offset);
+    if (header.version >= 2) {
+        fingerprint_ = SourceFingerprint{header.source_file_size, header.source_mtime_ns, header.source_num_traces,
+                                         header.source_trace_size, header.source_header_checksum};
+    }
+}
+
+TraceIndexFile::~TraceIndexFile() {
+    if (map_) {
+        munmap(const_cast<uint8_t*>(map_), map_size_);
+    }
+}
+
+void TraceIndexFile::write(const std::string& path,
+                           const std::vector<std::string>& keys,
+                           const std::vector<int32_t>& tuples,
+                           const std::vector<uint64_t>& offsets,
+                           const std::vector<int32_t>& indices,
+                           const SourceFingerprint& fingerprint) {
+    IndexHeader header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.num_keys = static_cast<uint32_t>(keys.size());
+    header.num_tuples = tuples.size() / keys.size();
+    header.num_indices = indices.size();
+    header.source_file_size = fingerprint.file_size;
+    header.source_mtime_ns = fingerprint.mtime_ns;
+    header.source_num_traces = fingerprint.num_traces;
+    header.source_trace_size = fingerprint.trace_size;
+    header.source_header_checksum = fingerprint.header_checksum;
+    if (offsets.size() != header.num_tuples + 1 || offsets.back() != indices.size()) {
+        throw std::invalid_argument("Inconsistent CSR arrays for trace index: " + path);
+    }
+
+    std::string names;
+    for (const auto& key : keys) {
+        names += key;
+        names.push_back('\0');
+    }
+    header.keys_offset = sizeof(IndexHeader);
+    header.keys_size = names.size();
+    header.tuples_offset = align8(header.keys_offset + header.keys_size);
+    header.offsets_offset = align8(header.tuples_offset + tuples.size() * sizeof(int32_t));
+    header.indices_offset = header.offsets_offset + offsets.size() * sizeof(uint64_t);
+    header.file_size = header.indices_offset + indices.size() * sizeof(int32_t);
+
+    // Пишем во временный файл и переименовываем, чтобы читатели не увидели половину индекса
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open trace index for writing: " + tmp_path);
+        }
+        auto pad_to = [&out](uint64_t offset) {
+            static const char zeros[8] = {};
+            uint64_t pos = static_cast<uint64_t>(out.tellp());
+            out.write(zeros, static_cast<std::streamsize>(offset - pos));
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(names.data(), static_cast<std::streamsize>(names.size()));
+        pad_to(header.tuples_offset);
+        out.write(reinterpret_cast<const char*>(tuples.data()), static_cast<std::streamsize>(tuples.size() * sizeof(int32_t)));
+        pad_to(header.offsets_offset);
+        out.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+        out.write(reinterpret_cast<const char*>(indices.data()), static_cast<std::streamsize>(indices.size() * sizeof(int32_t)));
+        if (!out) {
+            throw std::runtime_error("Failed to write trace index: " + tmp_path);
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+std::pair<uint64_t, uint64_t> TraceIndexFile::prefix_range(const int32_t* prefix, size_t prefix_len) const {
+    // lower_bound и upper_bound по первым prefix_len ключам
+    uint64_t lo = 0, hi = num_tuples_;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (compare_prefix(tuple(mid), prefix, prefix_len) < 0) lo = mid + 1; else hi = mid;
+    }
+    uint64_t first = lo;
+    hi = num_tuples_;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (compare_prefix(tuple(mid), prefix, prefix_len) <= 0) lo = mid + 1; else hi = mid;
+    }
+    return {first, lo};
+}
+
+std::optional<std::span<const int32_t>>
+TraceIndexFile::find_prefix(const std::vector<std::optional<int>>& key_values) const {
+    std::vector<int32_t> prefix;
+    size_t i = 0;
+    for (; i < num_keys_ && i < key_values.size() && key_values[i].has_value(); ++i) {
+        prefix.push_back(*key_values[i]);
+    }
+    for (size_t j = i; j < num_keys_ && j < key_values.size(); ++j) {
+        if (key_values[j].has_value()) return std::nullopt; // Не префикс
+    }
+
+    auto [first, last] = prefix_range(prefix.data(), prefix.size());
+    return std::span<const int32_t>(indices_ + offsets_[first], offsets_[last] - offsets_[first]);
+}
+
+std::vector<int> TraceIndexFile::find(const std::vector<std::optional<int>>& key_values) const {
+    if (auto span = find_prefix(key_values)) {
+        return {span->begin(), span->end()};
+    }
+
+    // Двоичный поиск по заданному префиксу, затем фильтрация остальных ключей
+    std::vector<int32_t> prefix;
+    for (size_t i = 0; i < num_keys_ && i < key_values.size() && key_values[i].has_value(); ++i) {
+        prefix.push_back(*key_values[i]);
+    }
+    auto [first, last] = prefix_range(prefix.data(), prefix.size());
+
+    std::vector<int> result;
+    for (uint64_t t = first; t < last; ++t) {
+        const int32_t* values = tuple(t);
+        bool match = true;
+        for (size_t k = prefix.size(); k < num_keys_ && k < key_values.size(); ++k) {
+            if (key_values[k].has_value() && values[k] != *key_values[k]) {
+                match = false;
+                break;
+            }
+        }
+        if (match) {
+            result.insert(result.end(), indices_ + offsets_[t], indices_ + offsets_[t + 1]);
+        }
+    }
+    return result;
+}
+
+std::vector<std::pair<int, std::vector<int>>> TraceIndexFile::find_range(size_t key_idx, int first, int last) const {
+    std::vector<std::pair<int, std::vector<int>>> result;
+    if (first > last) return result;
+
+    if (key_idx == 0) {
+        // Кортежи с первым ключом в диапазоне лежат подряд
+        int32_t lo_key = first;
+        uint64_t t = prefix_range(&lo_key, 1).first;
+        for (; t < num_tuples_ && tuple(t)[0] <= last; ++t) {
+            int value = tuple(t)[0];
+            if (result.empty() || result.back().first != value) result.emplace_back(value, std::vector<int>{});
+            auto& dst = result.back().second;
+            dst.insert(dst.end(), indices_ + offsets_[t], indices_ + offsets_[t + 1]);
+        }
+        return result;
+    }
+
+    std::map<int, std::vector<int>> grouped;
+    for (uint64_t t = 0; t < num_tuples_; ++t) {
+        int value = tuple(t)[key_idx];
+        if (value < first || value > last) continue;
+        auto& dst = grouped[value];
+        dst.insert(dst.end(), indices_ + offsets_[t], indices_ + offsets_[t + 1]);
+    }
+    result.assign(std::make_move_iterator(grouped.begin()), std::make_move_iterator(grouped.end()));
+    return result;
+}
+
+std::vector<int> TraceIndexFile::unique_values(size_t key_idx) const {
+    std::vector<int> values;
+    if (key_idx == 0) {
+        // Первый ключ уже отсортирован
+        for (uint64_t t = 0; t < num_tuples_; ++t) {
+            if (values.empty() || values.back() != tuple(t)[0]) values.push_back(tuple(t)[0]);
+        }
+        return values;
+    }
+    values.reserve(num_tuples_);
+    for (uint64_t t = 0; t < num_tuples_; ++t) {
+        values.push_back(tuple(t)[key_idx]);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return values;
+}
@@ -1,5 +1,7 @@
 #include "sgylib/TraceMap.hpp"
 #include "sgylib/SegyReader.hpp"
+#include "sgylib/TraceIndexFile.hpp"
+#include "sgylib/IndexCodec.hpp"
 #include "sgylib/TraceFieldMap.hpp"
 #include "sgylib/SegyUtil.hpp"
 #include <stdexcept>
@@ -8,6 +10,8 @@
 #include <unordered_map>
 #include <cstring>
 #include <iostream>
+#include <future>
+#include <filesystem>
 #include "util.hpp"
 
 // Заголовки для параллелизации и работы с БД
@@ -15,47 +19,84 @@
 #include <sqlite3.h>
 
 
-// Хеш-функция для std::vector<int>, нужна для временной карты в памяти
-struct VectorHash {
-    std::size_t operator()(const std::vector<int>& v) const {
-        std::size_t seed = v.size();
-        for (int i : v) {
-            seed ^= std::hash<int>{}(i) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        }
-        return seed;
+namespace {
+
+// Возвращает закешированный запрос в исходное состояние при выходе из области видимости
+struct StatementReset {
+    sqlite3_stmt* stmt;
+    ~StatementReset() {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
     }
 };
 
-TraceMap::TraceMap(const std::string& db_path, const std::vector<std::string>& keys)
-    : db_path_(db_path), keys_(keys) 
+// Декодирует индексы из BLOB-столбца в конец out без промежуточного вектора
+void append_blob_indices(sqlite3_stmt* stmt, int column, IndexEncoding encoding, uint64_t max_count,
+                         std::vector<int>& out) {
+    const void* blob = sqlite3_column_blob(stmt, column);
+    size_t size = static_cast<size_t>(sqlite3_column_bytes(stmt, column));
+    decode_indices(encoding, blob, size, max_count, out);
+}
+
+} // namespace
+
+TraceMap::TraceMap(const std::string& db_path, const std::vector<std::string>& keys, TraceMapBackend backend)
+    : db_path_(db_path), keys_(keys), backend_(backend)
 {
     if (keys.empty()) {
         throw std::invalid_argument("Keys vector cannot be empty.");
     }
+    if (keys.size() > 64) {
+        throw std::invalid_argument("TraceMap supports at most 64 keys.");
+    }
     // Проверяем наличие специального ключа 'sequence_number'
     if (!keys_.empty() && keys_.back() == "sequence_number") {
         has_seq_number_ = true;
         // Удаляем его из основного списка ключей, так как он обрабатывается особо
         keys_.pop_back(); 
     }
+    if (backend_ == TraceMapBackend::Binary) {
+        // Файл индекса появится после build_map
+        if (std::filesystem::exists(db_path_)) {
+            index_ = std::make_unique<TraceIndexFile>(db_path_, keys_);
+        }
+        return;
+    }
     open_db();
     create_table();
+    if (auto fingerprint = stored_fingerprint()) {
+        max_blob_indices_ = static_cast<uint64_t>(fingerprint->num_traces);
+    }
 }
 
 TraceMap::~TraceMap() {
+    for (auto& [shape, stmt] : find_stmts_) sqlite3_finalize(stmt);
+    for (auto& [key_idx, stmt] : range_stmts_) sqlite3_finalize(stmt);
     if (db_) {
         sqlite3_close(db_);
     }
 }
 
 void TraceMap::open_db() {
-    int rc = sqlite3_open(db_path_.c_str(), &db_);
+    // FULLMUTEX: одно соединение безопасно используется из нескольких потоков
+    int rc = sqlite3_open_v2(db_path_.c_str(), &db_,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Cannot open database: " + std::string(sqlite3_errmsg(db_)));
     }
     // Оптимизация для скорости записи
     sqlite3_exec(db_, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
     sqlite3_exec(db_, "PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
+
+    // Формат BLOB хранится в user_version: 0 - сырые int32 (карты, построенные до сжатия)
+    sqlite3_stmt* stmt;
+    check_db_error(sqlite3_prepare_v2(db_, "PRAGMA user_version;", -1, &stmt, nullptr), "Read user_version");
+    int version = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    if (version != static_cast<int>(IndexEncoding::Raw) && version != static_cast<int>(IndexEncoding::DeltaVarint)) {
+        throw std::runtime_error("Unsupported trace map encoding " + std::to_string(version) + " in " + db_path_);
+    }
+    blob_encoding_ = static_cast<IndexEncoding>(version);
 }
 
 void TraceMap::create_table() {
@@ -72,74 +113,290 @@ void TraceMap::create_table() {
     sql << "));";
 
     check_db_error(sqlite3_exec(db_, sql.str().c_str(), nullptr, nullptr, nullptr), "Table creation");
+
+    // Одна строка с отпечатком исходного файла (см. SourceFingerprint)
+    check_db_error(sqlite3_exec(db_,
+        "CREATE TABLE IF NOT EXISTS source_fingerprint ("
+        "id INTEGER PRIMARY KEY CHECK (id = 0), file_size INTEGER NOT NULL, mtime_ns INTEGER NOT NULL, "
+        "num_traces INTEGER NOT NULL, trace_size INTEGER NOT NULL, header_checksum INTEGER NOT NULL);",
+        nullptr, nullptr, nullptr), "Fingerprint table creation");
 }
 
 void TraceMap::build_map(const SegyReader& reader) {
+    build_maps(reader, {this});
+}
+
+void TraceMap::build_maps(const SegyReader& reader, const std::vector<TraceMap*>& maps) {
     std::cout << "Starting high-performance map build..." << std::endl;
     int n_traces = reader.num_traces();
-    size_t n_keys = keys_.size();
-    
-    // Определяем размер одного полного блока трассы (заголовок + данные)
-    const int trace_size = 240 + reader.num_samples() * 4;
-    
-    // Устанавливаем большой размер буфера для чтения (например, 256 МБ)
-    const size_t CHUNK_SIZE_BYTES = 256 * 1024 * 1024;
-    // Сколько полных трасс помещается в наш буфер
-    const int traces_per_chunk = CHUNK_SIZE_BYTES / trace_size;
+    auto entries = scan_traces(reader, std::vector<const TraceMap*>(maps.begin(), maps.end()), 0, n_traces);
+    const SourceFingerprint fingerprint = reader.fingerprint(n_traces);
+    for (size_t m = 0; m < maps.size(); ++m) {
+        maps[m]->write_entries(entries[m], fingerprint, false);
+        entries[m] = KeyEntries{}; // Освобождаем память до записи следующей карты
+    }
+    std::cout << (maps.size() == 1 ? "Trace map built successfully." : "Trace maps built successfully.") << std::endl;
+}
+
+TraceMapUpdate TraceMap::update_map(const SegyReader& reader) {
+    auto stored = stored_fingerprint();
+    int n_traces = reader.num_traces();
+
+    // Файл перезаписан, если не совпадает контрольная сумма проиндексированной части,
+    // размер трассы или трасс стало меньше. Тот же размер при другом mtime - перезапись на месте.
+    bool rewritten = !stored || stored->trace_size != reader.trace_size() || stored->num_traces > n_traces;
+    if (!rewritten) {
+        SourceFingerprint current = reader.fingerprint(static_cast<int>(stored->num_traces));
+        rewritten = current.header_checksum != stored->header_checksum ||
+                    (current.file_size == stored->file_size && current.mtime_ns != stored->mtime_ns);
+        if (!rewritten && stored->num_traces == n_traces) {
+            if (current != *stored) {
+                // Дописан неполный хвост трассы: карта актуальна, обновляем только отпечаток
+                write_entries({}, current, true);
+            }
+            return TraceMapUpdate::UpToDate;
+        }
+    }
+
+    if (rewritten) {
+        if (stored) {
+            std::cout << "Source file was rewritten since the trace map was built." << std::endl;
+        }
+        build_map(reader);
+        return TraceMapUpdate::Rebuilt;
+    }
+
+    int first_new = static_cast<int>(stored->num_traces);
+    std::cout << "Adding " << (n_traces - first_new) << " appended traces to the trace map..." << std::endl;
+    auto entries = scan_traces(reader, {this}, first_new, n_traces);
+    write_entries(entries[0], reader.fingerprint(n_traces), true);
+    std::cout << "Trace map updated successfully." << std::endl;
+    return TraceMapUpdate::Appended;
+}
+
+std::vector<TraceMap::KeyEntries> TraceMap::scan_traces(const SegyReader& reader, const std::vector<const TraceMap*>& maps,
+                                                        int start_trace, int end_trace) {
+    const size_t n_maps = maps.size();
+    const size_t n_records = static_cast<size_t>(std::max(0, end_trace - start_trace));
+
+    // Смещения полей-ключей разрешаются один раз; неизвестный ключ - ошибка до чтения файла
+    std::vector<HeaderKeySet> key_sets;
+    key_sets.reserve(n_maps);
+    for (const TraceMap* map : maps) key_sets.emplace_back(map->keys_);
     
-    // Временный буфер для чтения больших кусков файла
-    std::vector<char> buffer(traces_per_chunk * trace_size);
-
-    // --- Основная карта для агрегации результатов ---
-    using InMemoryMap = std::unordered_map<std::vector<int>, std::vector<int>, VectorHash>;
-    InMemoryMap final_map;
-
-    int traces_processed = 0;
-    while (traces_processed < n_traces) {
-        // Определяем, сколько трасс читать на этой итерации
-        int traces_to_read = std::min(traces_per_chunk, n_traces - traces_processed);
-        size_t bytes_to_read = traces_to_read * trace_size;
+    // Читаются только 240-байтовые заголовки. Пока OpenMP разбирает один блок
+    // заголовков, следующий читается в фоновом потоке (двойная буферизация).
+    const int HEADERS_PER_CHUNK = 256 * 1024;
+    std::vector<uint8_t> current(static_cast<size_t>(HEADERS_PER_CHUNK) * 240);
+    std::vector<uint8_t> next(current.size());
+
+    // Для длинных трасс заголовки читаются вразброс, упреждающее чтение отсчетов не нужно
+    if (reader.header_scan_is_strided()) {
+        reader.advise(AccessPattern::Random);
+    }
+
+    // Записи фиксированной ширины: для карты m n_keys значений ключей трассы start_trace + r
+    // лежат в keys[m][r * n_keys ...]. Индекс трассы - номер записи, отдельно не хранится.
+    std::vector<std::vector<int32_t>> keys(n_maps);
+    for (size_t m = 0; m < n_maps; ++m) keys[m].resize(n_records * key_sets[m].size());
+
+    auto read_chunk = [&reader, end_trace, HEADERS_PER_CHUNK](int start, std::vector<uint8_t>* dst) {
+        int count = std::min(HEADERS_PER_CHUNK, end_trace - start);
+        reader.read_headers(start, count, dst->data());
+    };
+
+    std::future<void> pending;
+    if (start_trace < end_trace) {
+        pending = std::async(std::launch::async, read_chunk, start_trace, &next);
+    }
+
+    int traces_processed = start_trace;
+    while (traces_processed < end_trace) {
+        // Определяем, сколько трасс в текущем блоке
+        int traces_to_read = std::min(HEADERS_PER_CHUNK, end_trace - traces_processed);
         
-        // 1. Читаем большой непрерывный блок с диска за один вызов
-        reader.read_raw_block(traces_processed, bytes_to_read, buffer.data());
+        // 1. Дожидаемся блока заголовков и сразу запускаем чтение следующего
+        pending.get();
+        std::swap(current, next);
+        if (traces_processed + traces_to_read < end_trace) {
+            pending = std::async(std::launch::async, read_chunk, traces_processed + traces_to_read, &next);
+        }
 
-        // 2. Параллельно обрабатываем заголовки из этого блока УЖЕ В ПАМЯТИ
-        std::vector<InMemoryMap> local_maps;
-        #pragma omp parallel
-        {
-            int thread_id = omp_get_thread_num();
-            #pragma omp single
-            {
-                local_maps.resize(omp_get_num_threads());
+        // 2. Ключи каждой трассы пишутся в ее собственную запись, без выделений памяти.
+        // Заголовок разбирается для всех карт сразу, пока он в кеше.
+        const size_t chunk_first = static_cast<size_t>(traces_processed - start_trace);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < traces_to_read; ++i) {
+            const uint8_t* header_ptr = current.data() + static_cast<size_t>(i) * 240;
+            for (size_t m = 0; m < n_maps; ++m) {
+                const size_t n_keys = key_sets[m].size();
+                key_sets[m].extract(header_ptr, keys[m].data() + (chunk_first + i) * n_keys);
             }
+        }
 
-            #pragma omp for schedule(dynamic)
-            for (int i = 0; i < traces_to_read; ++i) {
-                // Получаем указатель на заголовок внутри нашего буфера в памяти
-                const char* header_ptr = buffer.data() + i * trace_size;
-                
-                std::vector<int> key_vals(n_keys);
-                for (size_t j = 0; j < n_keys; ++j) {
-                    key_vals[j] = get_trace_field_value(reinterpret_cast<const uint8_t*>(header_ptr), keys_[j]);
-                }
-                
-                int global_trace_index = traces_processed + i;
-                local_maps[thread_id][key_vals].push_back(global_trace_index);
-            }
-        } // Конец параллельной секции
+        traces_processed += traces_to_read;
+        print_progress_bar("1/2 Reading & Processing", traces_processed - start_trace, end_trace - start_trace);
+    }
 
-        // 3. Сливаем результаты из локальных карт в общую
-        for (const auto& local_map : local_maps) {
-            for (const auto& pair : local_map) {
-                final_map[pair.first].insert(final_map[pair.first].end(), pair.second.begin(), pair.second.end());
+    if (reader.header_scan_is_strided()) {
+        reader.advise(AccessPattern::Normal);
+    }
+
+    std::vector<KeyEntries> entries(n_maps);
+    for (size_t m = 0; m < n_maps; ++m) {
+        entries[m] = group_records(keys[m], key_sets[m].size(), start_trace);
+        std::vector<int32_t>().swap(keys[m]);
+    }
+    return entries;
+}
+
+namespace {
+
+// Лексикографическое сравнение кортежей из n ключей
+inline bool tuple_less(const int32_t* a, const int32_t* b, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        if (a[k] != b[k]) return a[k] < b[k];
+    }
+    return false;
+}
+
+inline bool tuple_equal(const int32_t* a, const int32_t* b, size_t n) {
+    return std::equal(a, a + n, b);
+}
+
+// Параллельная сортировка: каждый поток сортирует свой участок, затем участки
+// попарно сливаются; на каждом уровне слияния пары обрабатываются параллельно.
+template <typename Less>
+void parallel_sort(std::vector<uint32_t>& order, Less less) {
+    const int parts = omp_get_max_threads();
+    const size_t n = order.size();
+    if (parts <= 1 || n < (size_t(1) << 16)) {
+        std::sort(order.begin(), order.end(), less);
+        return;
+    }
+
+    std::vector<size_t> bounds(parts + 1);
+    for (int p = 0; p <= parts; ++p) bounds[p] = n * p / parts;
+
+    #pragma omp parallel for schedule(static)
+    for (int p = 0; p < parts; ++p) {
+        std::sort(order.begin() + bounds[p], order.begin() + bounds[p + 1], less);
+    }
+    for (int width = 1; width < parts; width *= 2) {
+        #pragma omp parallel for schedule(dynamic)
+        for (int p = 0; p < parts; p += 2 * width) {
+            size_t mid = bounds[std::min(p + width, parts)];
+            size_t last = bounds[std::min(p + 2 * width, parts)];
+            std::inplace_merge(order.begin() + bounds[p], order.begin() + mid, order.begin() + last, less);
+        }
+    }
+}
+
+} // namespace
+
+TraceMap::KeyEntries TraceMap::group_records(const std::vector<int32_t>& keys, size_t n_keys, int first_trace) {
+    const size_t n = n_keys == 0 ? 0 : keys.size() / n_keys;
+    auto tuple_of = [&keys, n_keys](uint32_t r) { return keys.data() + static_cast<size_t>(r) * n_keys; };
+
+    // Порядок записей: по кортежу ключей, при равенстве - по индексу трассы.
+    // Файлы обычно уже отсортированы по ключам, тогда сортировка не нужна.
+    std::vector<uint32_t> order(n);
+    bool sorted = true;
+    #pragma omp parallel for schedule(static) reduction(&& : sorted)
+    for (size_t r = 0; r < n; ++r) {
+        order[r] = static_cast<uint32_t>(r);
+        if (r > 0 && tuple_less(tuple_of(r), tuple_of(r - 1), n_keys)) sorted = false;
+    }
+    if (!sorted) {
+        parallel_sort(order, [&](uint32_t a, uint32_t b) {
+            const int32_t* ta = tuple_of(a);
+            const int32_t* tb = tuple_of(b);
+            for (size_t k = 0; k < n_keys; ++k) {
+                if (ta[k] != tb[k]) return ta[k] < tb[k];
             }
+            return a < b;
+        });
+    }
+
+    // Группировка серий одинаковых кортежей в CSR. Каждый поток считает начала групп
+    // на своем участке, префиксная сумма дает номер первой группы участка.
+    KeyEntries entries;
+    entries.indices.resize(n);
+    std::vector<size_t> group_base;
+    auto is_group_start = [&](size_t p) {
+        return p == 0 || !tuple_equal(tuple_of(order[p]), tuple_of(order[p - 1]), n_keys);
+    };
+
+    #pragma omp parallel
+    {
+        const int parts = omp_get_num_threads();
+        const int part = omp_get_thread_num();
+        #pragma omp single
+        group_base.assign(parts + 1, 0);
+
+        const size_t lo = n * part / parts, hi = n * (part + 1) / parts;
+        size_t starts = 0;
+        for (size_t p = lo; p < hi; ++p) {
+            if (is_group_start(p)) ++starts;
+            entries.indices[p] = first_trace + static_cast<int32_t>(order[p]);
         }
+        group_base[part + 1] = starts;
 
-        traces_processed += traces_to_read;
-        print_progress_bar("1/2 Reading & Processing", traces_processed, n_traces);
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int i = 0; i < parts; ++i) group_base[i + 1] += group_base[i];
+            entries.tuples.resize(group_base[parts] * n_keys);
+            entries.offsets.resize(group_base[parts] + 1);
+            entries.offsets[group_base[parts]] = n;
+        }
+
+        size_t g = group_base[part];
+        for (size_t p = lo; p < hi; ++p) {
+            if (!is_group_start(p)) continue;
+            std::copy_n(tuple_of(order[p]), n_keys, entries.tuples.data() + g * n_keys);
+            entries.offsets[g] = p;
+            ++g;
+        }
     }
-    
-    // --- Шаг 4: Запись объединенной карты в SQLite (без изменений) ---
+    return entries;
+}
+
+void TraceMap::write_entries(const KeyEntries& entries, const SourceFingerprint& fingerprint, bool append) {
+    const size_t n_keys = keys_.size();
+    if (backend_ == TraceMapBackend::Binary) {
+        if (!append || !index_) {
+            write_index_file(entries, fingerprint);
+            return;
+        }
+        // Файл индекса неизменяемый: сливаем существующие кортежи с новыми (оба списка
+        // отсортированы) и записываем заново. Новые индексы больше старых, порядок сохраняется.
+        KeyEntries merged;
+        uint64_t old_t = 0, new_t = 0;
+        const uint64_t old_n = index_->num_tuples(), new_n = entries.size();
+        while (old_t < old_n || new_t < new_n) {
+            const int32_t* old_key = old_t < old_n ? index_->tuple_keys(old_t).data() : nullptr;
+            const int32_t* new_key = new_t < new_n ? entries.tuples.data() + new_t * n_keys : nullptr;
+            bool take_old = old_key && (!new_key || !tuple_less(new_key, old_key, n_keys));
+            bool take_new = new_key && (!old_key || !tuple_less(old_key, new_key, n_keys));
+            const int32_t* key = take_old ? old_key : new_key;
+            merged.tuples.insert(merged.tuples.end(), key, key + n_keys);
+            if (take_old) {
+                auto span = index_->tuple_indices(old_t++);
+                merged.indices.insert(merged.indices.end(), span.begin(), span.end());
+            }
+            if (take_new) {
+                merged.indices.insert(merged.indices.end(), entries.indices.begin() + entries.offsets[new_t],
+                                      entries.indices.begin() + entries.offsets[new_t + 1]);
+                ++new_t;
+            }
+            merged.offsets.push_back(merged.indices.size());
+        }
+        write_index_file(merged, fingerprint);
+        return;
+    }
+
+    // --- Запись карты в SQLite ---
     sqlite3_stmt* stmt;
     std::stringstream sql;
     sql << "INSERT OR REPLACE INTO trace_map (";
@@ -148,19 +405,57 @@ void TraceMap::build_map(const SegyReader& reader) {
     for(size_t i = 0; i < keys_.size(); ++i) sql << "?, ";
     sql << "?);";
 
-    check_db_error(sqlite3_exec(db_, "DELETE FROM trace_map;", nullptr, nullptr, nullptr), "Clear table");
+    std::lock_guard<std::mutex> lock(stmt_mutex_);
+    if (!append) {
+        check_db_error(sqlite3_exec(db_, "DELETE FROM trace_map;", nullptr, nullptr, nullptr), "Clear table");
+    }
     
     check_db_error(sqlite3_exec(db_, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr), "Begin transaction");
     check_db_error(sqlite3_prepare_v2(db_, sql.str().c_str(), -1, &stmt, nullptr), "Prepare insert");
 
+    // Новая карта пишется сжатой; при дописывании сохраняется формат существующей
+    if (!append) {
+        blob_encoding_ = IndexEncoding::DeltaVarint;
+        const std::string set_version = "PRAGMA user_version = " + std::to_string(static_cast<int>(blob_encoding_)) + ";";
+        check_db_error(sqlite3_exec(db_, set_version.c_str(), nullptr, nullptr, nullptr), "Set user_version");
+    }
+
+    // При дописывании новые индексы добавляются к уже сохраненным для того же кортежа
+    const uint64_t full_shape = keys_.size() == 64 ? ~uint64_t(0) : (uint64_t(1) << keys_.size()) - 1;
+    sqlite3_stmt* select = append ? cached_statement(find_stmts_, full_shape, [this]() {
+        std::stringstream select_sql;
+        select_sql << "SELECT indices FROM trace_map WHERE ";
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            select_sql << (i ? " AND " : "") << "\"" << keys_[i] << "\" = ?";
+        }
+        return select_sql.str();
+    }) : nullptr;
+
     int written_keys = 0;
-    int total_keys = final_map.size();
-    for (const auto& [key_vec, indices_vec] : final_map) {
-        for (size_t i = 0; i < key_vec.size(); ++i) {
-            sqlite3_bind_int(stmt, i + 1, key_vec[i]);
+    int total_keys = entries.size();
+    std::vector<int> merged;
+    std::vector<char> blob;
+    for (size_t g = 0; g < entries.size(); ++g) {
+        const int32_t* key_vals = entries.tuples.data() + g * n_keys;
+        std::span<const int> to_write(entries.indices.data() + entries.offsets[g], entries.offsets[g + 1] - entries.offsets[g]);
+        if (select) {
+            StatementReset reset{select};
+            for (size_t i = 0; i < n_keys; ++i) {
+                sqlite3_bind_int(select, i + 1, key_vals[i]);
+            }
+            merged.clear();
+            if (sqlite3_step(select) == SQLITE_ROW) {
+                append_blob_indices(select, 0, blob_encoding_, max_blob_indices_, merged);
+                merged.insert(merged.end(), to_write.begin(), to_write.end());
+                to_write = merged;
+            }
+        }
+
+        for (size_t i = 0; i < n_keys; ++i) {
+            sqlite3_bind_int(stmt, i + 1, key_vals[i]);
         }
-        auto blob = serialize_indices(indices_vec);
-        sqlite3_bind_blob(stmt, keys_.size() + 1, blob.data(), blob.size(), SQLITE_TRANSIENT);
+        serialize_indices(to_write, blob);
+        sqlite3_bind_blob(stmt, keys_.size() + 1, blob.data(), blob.size(), SQLITE_STATIC);
         
         if (sqlite3_step(stmt) != SQLITE_DONE) {/* обработка ошибки */}
         sqlite3_reset(stmt);
@@ -171,8 +466,65 @@ void TraceMap::build_map(const SegyReader& reader) {
     }
     
     sqlite3_finalize(stmt);
+
+    // Отпечаток меняется в той же транзакции, что и карта
+    sqlite3_stmt* fp_stmt;
+    check_db_error(sqlite3_prepare_v2(db_,
+        "INSERT OR REPLACE INTO source_fingerprint (id, file_size, mtime_ns, num_traces, trace_size, header_checksum) "
+        "VALUES (0, ?, ?, ?, ?, ?);", -1, &fp_stmt, nullptr), "Prepare fingerprint");
+    sqlite3_bind_int64(fp_stmt, 1, static_cast<sqlite3_int64>(fingerprint.file_size));
+    sqlite3_bind_int64(fp_stmt, 2, fingerprint.mtime_ns);
+    sqlite3_bind_int64(fp_stmt, 3, fingerprint.num_traces);
+    sqlite3_bind_int64(fp_stmt, 4, fingerprint.trace_size);
+    sqlite3_bind_int64(fp_stmt, 5, static_cast<sqlite3_int64>(fingerprint.header_checksum));
+    int rc = sqlite3_step(fp_stmt);
+    sqlite3_finalize(fp_stmt);
+    if (rc != SQLITE_DONE) check_db_error(rc, "Store fingerprint");
+
     check_db_error(sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr), "Commit transaction");
-    std::cout << "Trace map built successfully." << std::endl;
+    max_blob_indices_ = static_cast<uint64_t>(fingerprint.num_traces);
+}
+
+std::optional<SourceFingerprint> TraceMap::stored_fingerprint() const {
+    if (backend_ == TraceMapBackend::Binary) {
+        return index_ ? index_->fingerprint() : std::nullopt;
+    }
+
+    std::lock_guard<std::mutex> lock(stmt_mutex_);
+    sqlite3_stmt* stmt;
+    check_db_error(sqlite3_prepare_v2(db_,
+        "SELECT file_size, mtime_ns, num_traces, trace_size, header_checksum FROM source_fingerprint WHERE id = 0;",
+        -1, &stmt, nullptr), "Prepare fingerprint select");
+    std::optional<SourceFingerprint> result;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        result = SourceFingerprint{static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)), sqlite3_column_int64(stmt, 1),
+                                   sqlite3_column_int64(stmt, 2), sqlite3_column_int64(stmt, 3),
+                                   static_cast<uint64_t>(sqlite3_column_int64(stmt, 4))};
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+void TraceMap::write_index_file(const KeyEntries& entries, const SourceFingerprint& fingerprint) {
+    // Кортежи уже отсортированы, индексы внутри кортежа идут по возрастанию.
+    // Старое отображение закрывается до замены файла.
+    index_.reset();
+    TraceIndexFile::write(db_path_, keys_, entries.tuples, entries.offsets, entries.indices, fingerprint);
+    index_ = std::make_unique<TraceIndexFile>(db_path_, keys_);
+}
+
+std::span<const int> TraceMap::find_trace_span(const std::vector<std::optional<int>>& key_values) const {
+    if (!index_) {
+        throw std::logic_error("Zero-copy lookups require a built TraceMapBackend::Binary index: " + db_path_);
+    }
+    if (key_values.size() > keys_.size()) {
+        throw std::logic_error("Zero-copy lookups do not support 'sequence_number': " + db_path_);
+    }
+    auto span = index_->find_prefix(key_values);
+    if (!span) {
+        throw std::logic_error("Zero-copy lookups require the leading keys to be set: " + db_path_);
+    }
+    return *span;
 }
 
 std::vector<int> TraceMap::find_trace_indices(const std::vector<std::optional<int>>& key_values) const {
@@ -183,41 +535,148 @@ std::vector<int> TraceMap::find_trace_indices(const std::vector<std::optional<in
     if (has_seq_number_ && key_values.size() == keys_.size() + 1) {
         seq_num = key_values.back();
     }
+
+    if (backend_ == TraceMapBackend::Binary) {
+        if (!index_) {
+            throw std::runtime_error("Trace index has not been built: " + db_path_);
+        }
+        bool any_filter = std::any_of(key_values.begin(), key_values.begin() + std::min(key_values.size(), keys_.size()),
+                                      [](const std::optional<int>& v) { return v.has_value(); });
+        if (!any_filter) {
+            return {};
+        }
+        std::vector<std::optional<int>> filters(key_values.begin(), key_values.begin() + std::min(key_values.size(), keys_.size()));
+        return select_sequence_number(index_->find(filters), seq_num);
+    }
     
-    std::stringstream sql;
-    sql << "SELECT indices FROM trace_map WHERE ";
+    // Форма запроса - маска заданных ключей; для каждой формы SQL компилируется один раз
+    uint64_t shape = 0;
     std::vector<int> bind_values;
-    bool first_clause = true;
-
     for (size_t i = 0; i < keys_.size(); ++i) {
         if (i < key_values.size() && key_values[i].has_value()) {
-            if (!first_clause) sql << " AND ";
-            sql << "\"" << keys_[i] << "\" = ?";
+            shape |= uint64_t(1) << i;
             bind_values.push_back(*key_values[i]);
-            first_clause = false;
         }
     }
     
-    if (first_clause) { // Если не задано ни одного фильтра, возвращаем всё (или ничего)
+    if (shape == 0) { // Если не задано ни одного фильтра, возвращаем всё (или ничего)
         return {}; // или можно выбрать другое поведение
     }
 
-    sqlite3_stmt* stmt;
-    check_db_error(sqlite3_prepare_v2(db_, sql.str().c_str(), -1, &stmt, nullptr), "Prepare select");
+    std::vector<int> combined_indices;
+    {
+        std::lock_guard<std::mutex> lock(stmt_mutex_);
+        sqlite3_stmt* stmt = cached_statement(find_stmts_, shape, [this, shape]() {
+            std::stringstream sql;
+            sql << "SELECT indices FROM trace_map WHERE ";
+            bool first_clause = true;
+            for (size_t i = 0; i < keys_.size(); ++i) {
+                if (shape & (uint64_t(1) << i)) {
+                    if (!first_clause) sql << " AND ";
+                    sql << "\"" << keys_[i] << "\" = ?";
+                    first_clause = false;
+                }
+            }
+            return sql.str();
+        });
+        StatementReset reset{stmt};
 
-    for (size_t i = 0; i < bind_values.size(); ++i) {
-        sqlite3_bind_int(stmt, i + 1, bind_values[i]);
+        for (size_t i = 0; i < bind_values.size(); ++i) {
+            sqlite3_bind_int(stmt, i + 1, bind_values[i]);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            append_blob_indices(stmt, 0, blob_encoding_, max_blob_indices_, combined_indices);
+        }
     }
 
-    std::vector<int> combined_indices;
+    return select_sequence_number(std::move(combined_indices), seq_num);
+}
+
+std::vector<std::vector<int>> TraceMap::find_trace_indices_bulk(const std::string& key, const std::vector<int>& values) const {
+    std::vector<std::vector<int>> result(values.size());
+    if (values.empty()) return result;
+    const int key_idx = find_key_index(key);
+
+    std::vector<int> wanted(values);
+    std::sort(wanted.begin(), wanted.end());
+    wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+    // Значения первого ключа разрежены (например, несколько CDP по всей 3D-съемке): проход
+    // по диапазону читал бы почти всю карту, дешевле точечные запросы из кеша. По остальным
+    // ключам точечный запрос - тот же полный проход, поэтому для них всегда один проход
+    constexpr int64_t SPARSE_RATIO = 16;
+    const int64_t span = static_cast<int64_t>(wanted.back()) - wanted.front() + 1;
+    std::vector<std::pair<int, std::vector<int>>> groups;
+    if (key_idx == 0 && span > SPARSE_RATIO * static_cast<int64_t>(wanted.size())) {
+        std::vector<std::optional<int>> key_values(keys_.size());
+        for (int value : wanted) {
+            key_values[key_idx] = value;
+            std::vector<int> indices = find_trace_indices(key_values);
+            if (!indices.empty()) groups.emplace_back(value, std::move(indices));
+        }
+    } else {
+        // Один диапазонный проход; BLOB декодируются только у запрошенных значений
+        groups = scan_key_range(key_idx, wanted.front(), wanted.back(), &wanted);
+    }
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        auto it = std::lower_bound(groups.begin(), groups.end(), values[i],
+                                   [](const auto& group, int value) { return group.first < value; });
+        if (it != groups.end() && it->first == values[i]) result[i] = it->second;
+    }
+    return result;
+}
+
+std::vector<std::pair<int, std::vector<int>>> TraceMap::find_trace_indices_range(const std::string& key, int first, int last) const {
+    return scan_key_range(find_key_index(key), first, last, nullptr);
+}
+
+std::vector<std::pair<int, std::vector<int>>> TraceMap::scan_key_range(int key_idx, int first, int last,
+                                                                       const std::vector<int>* only) const {
+    auto skipped = [only](int value) { return only && !std::binary_search(only->begin(), only->end(), value); };
+
+    if (backend_ == TraceMapBackend::Binary) {
+        if (!index_) {
+            throw std::runtime_error("Trace index has not been built: " + db_path_);
+        }
+        auto result = index_->find_range(static_cast<size_t>(key_idx), first, last);
+        std::erase_if(result, [&](const auto& group) { return skipped(group.first); });
+        return result;
+    }
+
+    std::vector<std::pair<int, std::vector<int>>> result;
+    std::lock_guard<std::mutex> lock(stmt_mutex_);
+    sqlite3_stmt* stmt = cached_statement(range_stmts_, static_cast<uint64_t>(key_idx), [this, key_idx]() {
+        const std::string column = "\"" + keys_[key_idx] + "\"";
+        return "SELECT " + column + ", indices FROM trace_map WHERE " + column +
+               " BETWEEN ? AND ? ORDER BY " + column + ";";
+    });
+    StatementReset reset{stmt};
+
+    sqlite3_bind_int(stmt, 1, first);
+    sqlite3_bind_int(stmt, 2, last);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* blob = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
-        int blob_size = sqlite3_column_bytes(stmt, 0);
-        auto indices = deserialize_indices(blob, blob_size);
-        combined_indices.insert(combined_indices.end(), indices.begin(), indices.end());
+        int value = sqlite3_column_int(stmt, 0);
+        if (skipped(value)) continue;
+        if (result.empty() || result.back().first != value) result.emplace_back(value, std::vector<int>{});
+        append_blob_indices(stmt, 1, blob_encoding_, max_blob_indices_, result.back().second);
     }
-    sqlite3_finalize(stmt);
+    return result;
+}
+
+sqlite3_stmt* TraceMap::cached_statement(std::unordered_map<uint64_t, sqlite3_stmt*>& cache, uint64_t shape,
+                                         const std::function<std::string()>& make_sql) const {
+    auto it = cache.find(shape);
+    if (it != cache.end()) return it->second;
+
+    sqlite3_stmt* stmt = nullptr;
+    check_db_error(sqlite3_prepare_v3(db_, make_sql().c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr),
+                   "Prepare select");
+    cache.emplace(shape, stmt);
+    return stmt;
+}
 
+std::vector<int> TraceMap::select_sequence_number(std::vector<int> combined_indices, std::optional<int> seq_num) {
     // Если был запрошен конкретный номер, выбираем его из общего результата
     if (seq_num.has_value() && !combined_indices.empty()) {
         int idx = *seq_num;
@@ -233,6 +692,13 @@ std::vector<int> TraceMap::find_trace_indices(const std::vector<std::optional<in
 
 std::vector<int> TraceMap::get_unique_values(const std::string& key) const {
     int key_idx = find_key_index(key);
+
+    if (backend_ == TraceMapBackend::Binary) {
+        if (!index_) {
+            throw std::runtime_error("Trace index has not been built: " + db_path_);
+        }
+        return index_->unique_values(static_cast<size_t>(key_idx));
+    }
     
     std::stringstream sql;
     sql << "SELECT DISTINCT \"" << keys_[key_idx] << "\" FROM trace_map ORDER BY \"" << keys_[key_idx] << "\";";
@@ -249,6 +715,122 @@ std::vector<int> TraceMap::get_unique_values(const std::string& key) const {
     return unique_values;
 }
 
+std::vector<int> TraceMap::find_trace_indices_where(const std::vector<std::optional<KeyRange>>& ranges) const {
+    std::vector<int> group_key, indices;
+    open_cursor(0, ranges)->next(group_key, indices);
+    return indices;
+}
+
+std::unique_ptr<TraceMapCursor> TraceMap::open_cursor(size_t group_keys,
+                                                      const std::vector<std::optional<KeyRange>>& ranges) const {
+    if (group_keys > keys_.size()) {
+        throw std::invalid_argument("Cursor group has more keys than the TraceMap: " + std::to_string(group_keys));
+    }
+    if (ranges.size() > keys_.size()) {
+        throw std::invalid_argument("More key ranges than TraceMap keys: " + std::to_string(ranges.size()));
+    }
+    if (backend_ == TraceMapBackend::Binary && !index_) {
+        throw std::runtime_error("Trace index has not been built: " + db_path_);
+    }
+    return std::unique_ptr<TraceMapCursor>(new TraceMapCursor(*this, group_keys, ranges));
+}
+
+// --- Курсор ---
+
+TraceMapCursor::TraceMapCursor(const TraceMap& map, size_t group_keys, std::vector<std::optional<KeyRange>> ranges)
+    : map_(map), group_keys_(group_keys), ranges_(std::move(ranges)) {
+    ranges_.resize(map_.keys_.size());
+
+    if (map_.backend_ == TraceMapBackend::Binary) {
+        // Кортежи отсортированы: начинаем с первого подходящего по первому ключу
+        tuple_ = ranges_[0] ? map_.index_->lower_bound(ranges_[0]->first) : 0;
+        return;
+    }
+
+    std::stringstream sql;
+    sql << "SELECT ";
+    for (const auto& key : map_.keys_) sql << "\"" << key << "\", ";
+    sql << "indices FROM trace_map";
+    bool first_clause = true;
+    for (size_t i = 0; i < ranges_.size(); ++i) {
+        if (!ranges_[i]) continue;
+        sql << (first_clause ? " WHERE " : " AND ") << "\"" << map_.keys_[i] << "\" BETWEEN ? AND ?";
+        first_clause = false;
+    }
+    // Порядок совпадает с первичным ключом, поэтому сортировка идет по индексу таблицы
+    sql << " ORDER BY ";
+    for (size_t i = 0; i < map_.keys_.size(); ++i) {
+        sql << (i ? ", " : "") << "\"" << map_.keys_[i] << "\"";
+    }
+    sql << ";";
+
+    map_.check_db_error(sqlite3_prepare_v2(map_.db_, sql.str().c_str(), -1, &stmt_, nullptr), "Prepare cursor");
+    int param = 1;
+    for (const auto& range : ranges_) {
+        if (!range) continue;
+        sqlite3_bind_int(stmt_, param++, range->first);
+        sqlite3_bind_int(stmt_, param++, range->last);
+    }
+}
+
+TraceMapCursor::~TraceMapCursor() {
+    if (stmt_) {
+        sqlite3_finalize(stmt_);
+    }
+}
+
+bool TraceMapCursor::matches(const int32_t* tuple) const {
+    for (size_t k = 0; k < ranges_.size(); ++k) {
+        if (ranges_[k] && (tuple[k] < ranges_[k]->first || tuple[k] > ranges_[k]->last)) return false;
+    }
+    return true;
+}
+
+bool TraceMapCursor::next(std::vector<int>& group_key, std::vector<int>& indices) {
+    group_key.clear();
+    indices.clear();
+    if (done_) return false;
+
+    bool have_group = false;
+    if (map_.backend_ == TraceMapBackend::Binary) {
+        const TraceIndexFile& index = *map_.index_;
+        for (; tuple_ < index.num_tuples(); ++tuple_) {
+            const int32_t* values = index.tuple_keys(tuple_).data();
+            if (ranges_[0] && values[0] > ranges_[0]->last) break; // Дальше первый ключ только больше
+            if (!matches(values)) continue;
+            if (have_group && !std::equal(group_key.begin(), group_key.end(), values)) {
+                return true; // Кортеж начинает следующую группу
+            }
+            if (!have_group) {
+                group_key.assign(values, values + group_keys_);
+                have_group = true;
+            }
+            auto span = index.tuple_indices(tuple_);
+            indices.insert(indices.end(), span.begin(), span.end());
+        }
+        done_ = true;
+        return have_group;
+    }
+
+    const size_t n_keys = map_.keys_.size();
+    std::vector<int32_t> values(n_keys);
+    while (row_pending_ || sqlite3_step(stmt_) == SQLITE_ROW) {
+        row_pending_ = false;
+        for (size_t k = 0; k < n_keys; ++k) values[k] = sqlite3_column_int(stmt_, static_cast<int>(k));
+        if (have_group && !std::equal(group_key.begin(), group_key.end(), values.begin())) {
+            row_pending_ = true; // Строка начинает следующую группу, отдадим ее при следующем вызове
+            return true;
+        }
+        if (!have_group) {
+            group_key.assign(values.begin(), values.begin() + group_keys_);
+            have_group = true;
+        }
+        append_blob_indices(stmt_, static_cast<int>(n_keys), map_.blob_encoding_, map_.max_blob_indices_, indices);
+    }
+    done_ = true;
+    return have_group;
+}
+
 // --- Приватные хелперы ---
 
 void TraceMap::check_db_error(int error_code, const char* context) const {
@@ -269,14 +851,12 @@ int TraceMap::find_key_index(const std::string& key) const {
     return std::distance(keys_.begin(), it);
 }
 
-std::vector<char> TraceMap::serialize_indices(const std::vector<int>& indices) {
-    std::vector<char> blob(indices.size() * sizeof(int));
-    memcpy(blob.data(), indices.data(), blob.size());
-    return blob;
-}
-
-std::vector<int> TraceMap::deserialize_indices(const char* data, int size) {
-    std::vector<int> indices(size / sizeof(int));
-    memcpy(indices.data(), data, size);
-    return indices;
+void TraceMap::serialize_indices(std::span<const int> indices, std::vector<char>& blob) const {
+    blob.clear();
+    if (blob_encoding_ == IndexEncoding::Raw) {
+        blob.resize(indices.size() * sizeof(int));
+        memcpy(blob.data(), indices.data(), blob.size());
+        return;
+    }
+    encode_indices(indices, blob);
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include <vector>
+#include "stack/stack.hpp"
+
+// ------------------- Суммирование -------------------------
+std::vector<float> stack_traces(const std::vector<std::vector<float>>& traces) {
+    if (traces.empty()) return {};
+    int n = traces[0].size();
+    int m = traces.size();
+    std::vector<float> out(n, 0.0f);
+    float inv_m = 1.0f / m;
+
+    // Однопоточно: параллелизм - по CDP
+    for (int i = 0; i < n; ++i) {
+        float sum = 0.0f;
+        for (int j = 0; j < m; ++j) {
+            sum += traces[j][i];
+        }
+        out[i] = sum * inv_m;
+    }
+
+    return out;
+}
+
+std::vector<float> stack_traces(const Gather& gather) {
+    if (gather.empty()) return {};
+    int n = gather.num_samples();
+    int m = gather.num_traces();
+    std::vector<float> out(n, 0.0f);
+    float inv_m = 1.0f / m;
+
+    // Трассы лежат подряд в памяти: прибавляем их целиком, а не обходим по столбцам.
+    // Порядок сложения для каждого отсчета тот же, что и в версии для vector.
+    float* sum = out.data();
+    for (int j = 0; j < m; ++j) {
+        const float* trace = gather.trace(j);
+        #pragma omp simd
+        for (int i = 0; i < n; ++i) {
+            sum[i] += trace[i];
+        }
+    }
+
+    #pragma omp simd
+    for (int i = 0; i < n; ++i) {
+        sum[i] *= inv_m;
+    }
+
+    return out;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include "velocity/VelocityField.hpp"
+
+VelocityField::Function VelocityField::Cache::find(int cdp) {
+    auto it = index_.find(cdp);
+    if (it == index_.end()) return nullptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+}
+
+void VelocityField::Cache::insert(int cdp, Function function) {
+    entries_.emplace_front(cdp, std::move(function));
+    index_[cdp] = entries_.begin();
+    if (entries_.size() > capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+VelocityField::VelocityField(std::vector<int> control_cdps, ControlLoader loader, int num_samples, float dt,
+                             std::size_t cache_size)
+    : control_cdps_(std::move(control_cdps)),
+      loader_(std::move(loader)),
+      num_samples_(num_samples),
+      dt_(dt),
+      functions_(cache_size),
+      controls_(cache_size) {
+    if (control_cdps_.empty()) {
+        throw std::invalid_argument("Velocity field has no control CDPs");
+    }
+    if (num_samples_ < 1) {
+        throw std::invalid_argument("Velocity field needs at least one sample: " + std::to_string(num_samples_));
+    }
+    std::sort(control_cdps_.begin(), control_cdps_.end());
+    control_cdps_.erase(std::unique(control_cdps_.begin(), control_cdps_.end()), control_cdps_.end());
+}
+
+namespace {
+std::vector<int> control_keys(const ControlFunctions& controls) {
+    std::vector<int> cdps;
+    cdps.reserve(controls.size());
+    for (const auto& [cdp, points] : controls) cdps.push_back(cdp);
+    return cdps;
+}
+} // namespace
+
+VelocityField::VelocityField(ControlFunctions controls, int num_samples, float dt, std::size_t cache_size)
+    : VelocityField(std::make_shared<const ControlFunctions>(std::move(controls)), num_samples, dt, cache_size) {}
+
+VelocityField::VelocityField(std::shared_ptr<const ControlFunctions> controls, int num_samples, float dt,
+                             std::size_t cache_size)
+    : VelocityField(control_keys(*controls), [controls](int cdp) { return controls->at(cdp); }, num_samples, dt,
+                    cache_size) {}
+
+VelocityField::Function VelocityField::resample(std::vector<std::pair<float, float>> points) const {
+    if (points.empty()) {
+        throw std::runtime_error("Empty control function in velocity field");
+    }
+    std::stable_sort(points.begin(), points.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Отсчеты и точки идут по возрастанию времени: один проход слиянием.
+    // upper - первая точка со временем >= t
+    auto out = std::make_shared<std::vector<float>>(num_samples_);
+    size_t upper = 0;
+    for (int i = 0; i < num_samples_; ++i) {
+        const float t = i * dt_;
+        while (upper < points.size() && points[upper].first < t) ++upper;
+        if (upper == points.size()) {
+            (*out)[i] = points.back().second;
+        } else if (upper == 0) {
+            (*out)[i] = points.front().second;
+        } else {
+            const auto& [t1, v1] = points[upper - 1];
+            const auto& [t2, v2] = points[upper];
+            const float alpha = (t - t1) / (t2 - t1);
+            (*out)[i] = v1 + alpha * (v2 - v1);
+        }
+    }
+    return out;
+}
+
+VelocityField::Function VelocityField::control(int cdp) {
+    if (Function cached = controls_.find(cdp)) return cached;
+    Function function = resample(loader_(cdp));
+    controls_.insert(cdp, function);
+    return function;
+}
+
+std::shared_ptr<const std::vector<float>> VelocityField::at(int cdp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Function cached = functions_.find(cdp)) return cached;
+
+    // Ближайшие контрольные CDP слева и справа; за краями - крайняя
+    auto right = std::lower_bound(control_cdps_.begin(), control_cdps_.end(), cdp);
+    Function function;
+    if (right == control_cdps_.end()) {
+        function = control(control_cdps_.back());
+    } else if (*right == cdp || right == control_cdps_.begin()) {
+        function = control(*right);
+    } else {
+        const int left_cdp = *std::prev(right);
+        const int right_cdp = *right;
+        Function left = control(left_cdp);
+        Function right_function = control(right_cdp);
+        const float w = static_cast<float>(cdp - left_cdp) / static_cast<float>(right_cdp - left_cdp);
+        auto blended = std::make_shared<std::vector<float>>(num_samples_);
+        const float* a = left->data();
+        const float* b = right_function->data();
+        float* out = blended->data();
+        #pragma omp simd
+        for (int i = 0; i < num_samples_; ++i) {
+            out[i] = a[i] + w * (b[i] - a[i]);
+        }
+        function = std::move(blended);
+    }
+    functions_.insert(cdp, function);
+    return function;
+}
@@ -0,0 +1,160 @@
+#include "velocity/VelocityStore.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+// POSIX: отображение файла в память
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char STORE_MAGIC[8] = {'S', 'G', 'Y', 'V', 'E', 'L', 'S', '\0'};
+constexpr uint32_t STORE_VERSION = 1;
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_samples;
+    float dt;
+    uint32_t reserved;
+    uint64_t num_cdps;
+    uint64_t cdps_offset;
+    uint64_t values_offset;
+    uint64_t file_size;
+    uint64_t source_file_size;
+    int64_t source_mtime_ns;
+};
+
+// Функции выравниваются по 64 байта от начала файла (отображение выровнено по странице)
+uint64_t align64(uint64_t v) { return (v + 63) & ~uint64_t(63); }
+
+} // namespace
+
+VelocityStore::VelocityStore(const std::string& path)
+    : path_(path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open velocity store: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(StoreHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Velocity store is truncated: " + path);
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    void* ptr = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map velocity store into memory: " + path);
+    }
+    map_ = static_cast<const uint8_t*>(ptr);
+
+    StoreHeader header{};
+    std::memcpy(&header, map_, sizeof(header));
+    try {
+        if (std::memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0) {
+            throw std::runtime_error("Not a velocity store file: " + path);
+        }
+        if (header.version != STORE_VERSION) {
+            throw std::runtime_error("Unsupported velocity store version " + std::to_string(header.version) + ": " +
+                                     path);
+        }
+        if (header.file_size != map_size_ ||
+            header.cdps_offset + header.num_cdps * sizeof(int32_t) > header.values_offset ||
+            header.values_offset + header.num_cdps * header.num_samples * sizeof(float) > map_size_) {
+            throw std::runtime_error("Velocity store is truncated: " + path);
+        }
+    } catch (...) {
+        munmap(const_cast<uint8_t*>(map_), map_size_);
+        throw;
+    }
+
+    num_samples_ = static_cast<int>(header.num_samples);
+    dt_ = header.dt;
+    num_cdps_ = header.num_cdps;
+    cdps_ = reinterpret_cast<const int32_t*>(map_ + header.cdps_offset);
+    values_ = reinterpret_cast<const float*>(map_ + header.values_offset);
+    source_.file_size = header.source_file_size;
+    source_.mtime_ns = header.source_mtime_ns;
+
+    // CDP обрабатываются по возрастанию: агрессивное упреждающее чтение функций
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = header.values_offset - header.values_offset % page;
+    madvise(const_cast<uint8_t*>(map_) + begin, map_size_ - begin, MADV_SEQUENTIAL);
+}
+
+VelocityStore::~VelocityStore() {
+    if (map_) {
+        munmap(const_cast<uint8_t*>(map_), map_size_);
+    }
+}
+
+void VelocityStore::build(const std::string& path, VelocityField& field, std::vector<int> cdps, float dt,
+                          const SourceFingerprint& source) {
+    std::sort(cdps.begin(), cdps.end());
+    cdps.erase(std::unique(cdps.begin(), cdps.end()), cdps.end());
+
+    StoreHeader header{};
+    std::memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version = STORE_VERSION;
+    header.num_samples = static_cast<uint32_t>(field.num_samples());
+    header.dt = dt;
+    header.num_cdps = cdps.size();
+    header.cdps_offset = sizeof(StoreHeader);
+    header.values_offset = align64(header.cdps_offset + cdps.size() * sizeof(int32_t));
+    header.file_size = header.values_offset + cdps.size() * header.num_samples * sizeof(float);
+    header.source_file_size = source.file_size;
+    header.source_mtime_ns = source.mtime_ns;
+
+    // Пишем во временный файл и переименовываем, чтобы читатели не увидели половину хранилища.
+    // Функции строятся и пишутся по одной, память не зависит от числа CDP
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open velocity store for writing: " + tmp_path);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        const std::vector<int32_t> keys(cdps.begin(), cdps.end());
+        out.write(reinterpret_cast<const char*>(keys.data()), static_cast<std::streamsize>(keys.size() * sizeof(int32_t)));
+        static const char zeros[64] = {};
+        out.write(zeros, static_cast<std::streamsize>(header.values_offset - static_cast<uint64_t>(out.tellp())));
+        for (int cdp : cdps) {
+            auto function = field.at(cdp);
+            out.write(reinterpret_cast<const char*>(function->data()),
+                      static_cast<std::streamsize>(function->size() * sizeof(float)));
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write velocity store: " + tmp_path);
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+SourceFingerprint VelocityStore::source_fingerprint(const std::string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Cannot stat velocity file: " + path);
+    }
+    SourceFingerprint fp;
+    fp.file_size = static_cast<uint64_t>(st.st_size);
+    fp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return fp;
+}
+
+bool VelocityStore::matches(const SourceFingerprint& source, int num_samples, float dt) const {
+    return source_.file_size == source.file_size && source_.mtime_ns == source.mtime_ns &&
+           num_samples_ == num_samples && dt_ == dt;
+}
+
+std::span<const float> VelocityStore::at(int cdp) const {
+    const int32_t* end = cdps_ + num_cdps_;
+    const int32_t* it = std::lower_bound(cdps_, end, cdp);
+    if (it == end || *it != cdp) return {};
+    return {values_ + static_cast<size_t>(it - cdps_) * num_samples_, static_cast<size_t>(num_samples_)};
+}
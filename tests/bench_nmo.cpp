@@ -0,0 +1,83 @@
+// Замер пропускной способности NMO: время NmoEngine::set_velocity + apply на один сейсмосбор
+// для каждого режима интерполяции и каждого ядра, поддерживаемого процессором.
+// Один поток, 120 трасс x 3000 отсчетов, все удаления разные (таблицы не переиспользуются).
+// Запуск: bench_nmo [повторов] [ядро]
+#include "nmo/nmo.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int NUM_TRACES = 120;
+constexpr int NUM_SAMPLES = 3000;
+constexpr float DT = 0.002f;
+constexpr float STRETCH_MUTE_PERCENT = 30.0f;
+
+struct Case {
+    const char* name;
+    NmoInterpolationOptions options;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int repeats = argc > 1 ? std::max(1, std::atoi(argv[1])) : 40;
+    std::vector<std::string> kernels;
+    if (argc > 2) {
+        kernels.push_back(argv[2]);
+    } else {
+        kernels = {"scalar", "avx2", "avx512"};
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> amplitude(-1.0f, 1.0f);
+    Gather input(NUM_TRACES, NUM_SAMPLES);
+    std::vector<float> offsets(NUM_TRACES);
+    for (int i = 0; i < NUM_TRACES; ++i) {
+        offsets[i] = 13.7f * static_cast<float>(i) + 5.0f;
+        float* trace = input.trace(i);
+        for (int s = 0; s < NUM_SAMPLES; ++s) trace[s] = amplitude(rng);
+    }
+    std::vector<float> velocities(NUM_SAMPLES);
+    for (int s = 0; s < NUM_SAMPLES; ++s) velocities[s] = 1500.0f + 1.3f * static_cast<float>(s);
+
+    const std::vector<Case> cases = {
+        {"nearest", {NmoInterpolation::Nearest}},
+        {"linear", {NmoInterpolation::Linear}},
+        {"cubic", {NmoInterpolation::Cubic}},
+        {"sinc 8/32", {NmoInterpolation::Sinc, 8, 32}},
+        {"sinc 8/128", {NmoInterpolation::Sinc, 8, 128}},
+        {"sinc 16/32", {NmoInterpolation::Sinc, 16, 32}},
+    };
+
+    std::printf("%d traces x %d samples, %d repeats, 1 thread\n", NUM_TRACES, NUM_SAMPLES, repeats);
+    for (const std::string& kernel : kernels) {
+        if (!set_nmo_kernel(kernel)) {
+            std::printf("%s: not supported, skipped\n", kernel.c_str());
+            continue;
+        }
+        for (const Case& c : cases) {
+            NmoEngine engine(c.options);
+            Gather output;
+            // Прогрев: выделение буферов и построение таблицы sinc
+            engine.set_velocity(velocities, DT, STRETCH_MUTE_PERCENT);
+            engine.apply(input, offsets, output);
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; ++r) {
+                engine.set_velocity(velocities, DT, STRETCH_MUTE_PERCENT);
+                engine.apply(input, offsets, output);
+            }
+            const auto stop = std::chrono::steady_clock::now();
+            const double ms = std::chrono::duration<double, std::milli>(stop - start).count() / repeats;
+            std::printf("%-7s %-11s %7.2f ms/gather %8.1f Msamples/s\n", nmo_kernel(), c.name, ms,
+                        NUM_TRACES * static_cast<double>(NUM_SAMPLES) / ms / 1e3);
+        }
+    }
+    return 0;
+}
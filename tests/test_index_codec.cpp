@@ -0,0 +1,169 @@
+// Кодек списков индексов трасс (Raw, DeltaVarint): круговое преобразование, формат серий,
+// быстрый путь однобайтовых разностей, усеченные и поврежденные BLOB, граница max_count.
+#include "sgylib/IndexCodec.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t NO_LIMIT = std::numeric_limits<int>::max();
+
+int failures = 0;
+
+void fail(const std::string& what, const std::string& message) {
+    if (++failures <= 20) std::printf("%s: %s\n", what.c_str(), message.c_str());
+}
+
+std::vector<char> encode(const std::vector<int>& indices) {
+    std::vector<char> blob;
+    encode_indices(indices, blob);
+    return blob;
+}
+
+// true, если decode_indices бросил std::runtime_error
+bool decode_throws(IndexEncoding encoding, const std::vector<char>& blob, size_t size, uint64_t max_count) {
+    std::vector<int> out;
+    try {
+        decode_indices(encoding, blob.data(), size, max_count, out);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void check_round_trip(const std::string& what, const std::vector<int>& indices) {
+    const std::vector<char> blob = encode(indices);
+
+    // Результат дописывается в конец out, уже лежащие там индексы не трогаются
+    std::vector<int> out = {-7};
+    decode_indices(IndexEncoding::DeltaVarint, blob.data(), blob.size(), indices.size(), out);
+    const std::vector<int> expected_out = [&] {
+        std::vector<int> v = {-7};
+        v.insert(v.end(), indices.begin(), indices.end());
+        return v;
+    }();
+    if (out != expected_out) {
+        fail(what, "round trip mismatch");
+        return;
+    }
+
+    // Каждый строгий префикс BLOB - поврежденные данные, а не частичный список
+    for (size_t size = 0; size < blob.size(); ++size) {
+        if (!decode_throws(IndexEncoding::DeltaVarint, blob, size, NO_LIMIT)) {
+            fail(what, "truncation to " + std::to_string(size) + " of " + std::to_string(blob.size()) +
+                           " bytes was accepted");
+            break;
+        }
+    }
+
+    // max_count: ровно число индексов допустимо, на единицу меньше - нет
+    if (!indices.empty() && !decode_throws(IndexEncoding::DeltaVarint, blob, blob.size(), indices.size() - 1)) {
+        fail(what, "count above max_count was accepted");
+    }
+}
+
+void check_bytes(const std::string& what, const std::vector<int>& indices, const std::vector<char>& expected) {
+    if (encode(indices) != expected) fail(what, "unexpected encoding");
+    check_round_trip(what, indices);
+}
+
+} // namespace
+
+int main() {
+    // Формат: [число] [(len << 1 | is_run)] [zigzag-разности]
+    check_bytes("empty", {}, {0});
+    // Серия из 3 шагов короче MIN_RUN_LENGTH - литералы: разности 5, 1, 1
+    check_bytes("run shorter than minimum", {5, 6, 7}, {3, 3 << 1, 10, 2, 2});
+    // Серия ровно из MIN_RUN_LENGTH шагов после литерала
+    check_bytes("run of minimum length", {5, 6, 7, 8, 9}, {5, 1 << 1, 10, (4 << 1) | 1, 2});
+    // Длинная серия, затем литерал и серия с отрицательным шагом
+    {
+        std::vector<int> indices;
+        for (int i = 0; i < 1000; ++i) indices.push_back(3 * i);
+        indices.push_back(5000);
+        for (int i = 0; i < 50; ++i) indices.push_back(4000 - 10 * i);
+        check_round_trip("long runs with negative step", indices);
+        if (encode(indices).size() > 16) fail("long runs with negative step", "runs were not used");
+    }
+    // Отрицательные разности и границы int в литералах
+    check_round_trip("negative deltas", {10, 3, 8, -4, 0, 0, 1});
+    check_round_trip("int limits", {std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 0,
+                                    std::numeric_limits<int>::min(), std::numeric_limits<int>::max()});
+    // Быстрый путь: 8 и больше однобайтовых разностей подряд (|d| < 64), в том числе отрицательных,
+    // и хвосты короче восьми
+    for (int n : {7, 8, 9, 16, 17, 100}) {
+        std::vector<int> indices;
+        int value = 1000;
+        for (int i = 0; i < n; ++i) {
+            value += (i % 3 == 0) ? -((i % 50) + 1) : (i % 60) + 1;
+            indices.push_back(value);
+        }
+        check_round_trip("one-byte deltas x" + std::to_string(n), indices);
+    }
+    // Однобайтовые разности, прерванные многобайтовой в разных позициях восьмерки
+    for (int pos = 0; pos < 9; ++pos) {
+        std::vector<int> indices;
+        int value = 0;
+        for (int i = 0; i < 20; ++i) {
+            value += (i == pos) ? 100000 : (i % 2 ? 2 : -1);
+            indices.push_back(value);
+        }
+        check_round_trip("multi-byte delta at " + std::to_string(pos), indices);
+    }
+    // Случайные списки: отсортированные с повторяющимися шагами и произвольные
+    std::mt19937 rng(7);
+    for (int iter = 0; iter < 200; ++iter) {
+        std::uniform_int_distribution<int> length(0, 300);
+        std::uniform_int_distribution<int> step(0, 5);
+        std::uniform_int_distribution<int> any(-1000000, 1000000);
+        std::vector<int> indices(length(rng));
+        int value = 0;
+        for (int& v : indices) {
+            if (iter % 2) {
+                v = any(rng);
+            } else {
+                value += step(rng) < 3 ? 1 : 37 * step(rng);
+                v = value;
+            }
+        }
+        check_round_trip("random " + std::to_string(iter), indices);
+    }
+
+    // Поврежденные BLOB: нулевая длина сегмента, сегмент длиннее списка,
+    // огромное число индексов, varint без завершающего байта
+    const std::vector<std::pair<const char*, std::vector<char>>> corrupted = {
+        {"zero segment length", {2, 0, 2, 2}},
+        {"segment longer than count", {2, (3 << 1) | 1, 2}},
+        {"huge count", {char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), 0x01}},
+        {"unterminated varint", {1, 1 << 1, char(0x80), char(0x80)}},
+        {"varint longer than 64 bits", {1, 1 << 1, char(0x80), char(0x80), char(0x80), char(0x80), char(0x80),
+                                        char(0x80), char(0x80), char(0x80), char(0x80), char(0x80), 0x01}},
+    };
+    for (const auto& [what, blob] : corrupted) {
+        if (!decode_throws(IndexEncoding::DeltaVarint, blob, blob.size(), NO_LIMIT)) fail(what, "was accepted");
+    }
+
+    // Raw: int32 в порядке байтов машины, число индексов ограничено max_count
+    {
+        const std::vector<int> indices = {4, -2, 9};
+        std::vector<char> blob(indices.size() * sizeof(int));
+        std::memcpy(blob.data(), indices.data(), blob.size());
+        std::vector<int> out;
+        decode_indices(IndexEncoding::Raw, blob.data(), blob.size(), indices.size(), out);
+        if (out != indices) fail("raw", "round trip mismatch");
+        if (!decode_throws(IndexEncoding::Raw, blob, blob.size(), indices.size() - 1)) {
+            fail("raw", "count above max_count was accepted");
+        }
+    }
+    if (!decode_throws(static_cast<IndexEncoding>(2), {0}, 1, NO_LIMIT)) fail("unknown encoding", "was accepted");
+
+    std::printf("%s\n", failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
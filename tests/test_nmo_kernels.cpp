@@ -0,0 +1,110 @@
+// Ядра интерполяции NMO (scalar, AVX2, AVX-512) на одних и тех же сейсмосборах.
+// Векторные ядра складывают произведения в другом порядке, поэтому сравнение - с допуском
+// порядка ошибки округления float. Покрываются фильтры до 8 точек (маскированный хвост),
+// 12, 16 и больше (полные векторы, дерево hadd) и трассы короче фильтра.
+#include "nmo/nmo.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr float DT = 0.002f;
+constexpr float STRETCH_MUTE_PERCENT = 60.0f;
+constexpr float TOLERANCE = 1e-5f; // Относительно max(1, |значение|)
+
+struct Case {
+    const char* name;
+    NmoInterpolationOptions options;
+};
+
+// Сейсмосбор из случайных отсчетов; удаления повторяются, чтобы таблицы переиспользовались
+Gather make_gather(int num_traces, int num_samples, std::mt19937& rng, std::vector<float>& offsets) {
+    std::uniform_real_distribution<float> amplitude(-1.0f, 1.0f);
+    Gather gather(num_traces, num_samples);
+    offsets.resize(num_traces);
+    for (int i = 0; i < num_traces; ++i) {
+        offsets[i] = 25.0f * static_cast<float>((i * 7) % 23);
+        float* trace = gather.trace(i);
+        for (int s = 0; s < num_samples; ++s) trace[s] = amplitude(rng);
+    }
+    return gather;
+}
+
+Gather correct(const std::string& kernel, const NmoInterpolationOptions& options, const Gather& input,
+               const std::vector<float>& offsets, const std::vector<float>& velocities) {
+    set_nmo_kernel(kernel);
+    NmoEngine engine(options);
+    engine.set_velocity(velocities, DT, STRETCH_MUTE_PERCENT);
+    Gather output;
+    engine.apply(input, offsets, output);
+    return output;
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::string> kernels;
+    for (const char* kernel : {"scalar", "avx2", "avx512"}) {
+        if (set_nmo_kernel(kernel)) {
+            kernels.push_back(kernel);
+        } else {
+            std::printf("%s: not supported, skipped\n", kernel);
+        }
+    }
+    if (kernels.empty() || kernels.front() != "scalar") {
+        std::printf("Scalar NMO kernel could not be selected\n");
+        return 1;
+    }
+
+    const std::vector<Case> cases = {
+        {"nearest", {NmoInterpolation::Nearest}},
+        {"linear", {NmoInterpolation::Linear}},
+        {"cubic", {NmoInterpolation::Cubic}},
+        {"sinc 2", {NmoInterpolation::Sinc, 2}},
+        {"sinc 6", {NmoInterpolation::Sinc, 6}},
+        {"sinc 8", {NmoInterpolation::Sinc, 8}},
+        {"sinc 12", {NmoInterpolation::Sinc, 12}},
+        {"sinc 16", {NmoInterpolation::Sinc, 16}},
+        {"sinc 24", {NmoInterpolation::Sinc, 24}},
+        {"sinc 64", {NmoInterpolation::Sinc, 64}},
+    };
+    // Длины трасс: короче фильтра и не кратные ширине вектора
+    const std::vector<int> lengths = {1, 5, 13, 37, 301};
+
+    std::mt19937 rng(2024);
+    int failures = 0;
+    for (const Case& c : cases) {
+        for (int num_samples : lengths) {
+            std::vector<float> offsets;
+            const Gather input = make_gather(40, num_samples, rng, offsets);
+            std::vector<float> velocities(num_samples);
+            for (int s = 0; s < num_samples; ++s) velocities[s] = 1500.0f + 2.0f * static_cast<float>(s);
+
+            const Gather reference = correct("scalar", c.options, input, offsets, velocities);
+            for (size_t k = 1; k < kernels.size(); ++k) {
+                const Gather output = correct(kernels[k], c.options, input, offsets, velocities);
+                float max_error = 0.0f;
+                for (int i = 0; i < input.num_traces(); ++i) {
+                    for (int s = 0; s < num_samples; ++s) {
+                        const float expected = reference.trace(i)[s];
+                        const float error = std::fabs(output.trace(i)[s] - expected) / std::max(1.0f, std::fabs(expected));
+                        max_error = std::max(max_error, error);
+                    }
+                }
+                if (!(max_error <= TOLERANCE)) {
+                    ++failures;
+                    std::printf("%s vs scalar, %s, %d samples: max error %g\n", kernels[k].c_str(), c.name,
+                                num_samples, max_error);
+                }
+            }
+        }
+    }
+
+    for (size_t k = 1; k < kernels.size(); ++k) {
+        std::printf("%s: %s\n", kernels[k].c_str(), failures == 0 ? "ok" : "see errors above");
+    }
+    return failures == 0 ? 0 : 1;
+}
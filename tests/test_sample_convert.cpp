@@ -0,0 +1,134 @@
+// Побитное сравнение пакетной конвертации IBM <-> IEEE со скалярными
+// ibm_to_float / ieee_to_ibm для каждой реализации, поддерживаемой процессором.
+#include "sgylib/SampleConvert.hpp"
+#include "sgylib/SegyUtil.hpp"
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+// Ожидаемое слово IBM: Inf/NaN - максимальное по модулю число со знаком исходного
+uint32_t reference_ibm(float val) {
+    const uint32_t bits = std::bit_cast<uint32_t>(val);
+    if (((bits >> 23) & 0xFF) == 0xFF) return (bits & 0x80000000u) | 0x7FFFFFFFu;
+    return ieee_to_ibm(val);
+}
+
+void check_ibm_to_float(const char* kernel, const char* what, const std::vector<uint32_t>& words) {
+    std::vector<uint8_t> src(words.size() * 4);
+    for (size_t i = 0; i < words.size(); ++i) {
+        put_u32_be(src.data() + i * 4, words[i]);
+    }
+    std::vector<float> dst(words.size());
+    ibm_to_float_block(src.data(), dst.data(), words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        const uint32_t expected = std::bit_cast<uint32_t>(ibm_to_float(words[i]));
+        const uint32_t actual = std::bit_cast<uint32_t>(dst[i]);
+        if (actual != expected && ++failures <= 20) {
+            std::printf("%s ibm_to_float %s [%zu/%zu]: ibm %08x -> %08x, expected %08x\n", kernel, what, i,
+                        words.size(), words[i], actual, expected);
+        }
+    }
+}
+
+void check_float_to_ibm(const char* kernel, const char* what, const std::vector<float>& values) {
+    std::vector<uint8_t> dst(values.size() * 4);
+    float_to_ibm_block(values.data(), dst.data(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        const uint32_t expected = reference_ibm(values[i]);
+        const uint32_t actual = get_u32_be(dst.data() + i * 4);
+        if (actual != expected && ++failures <= 20) {
+            std::printf("%s float_to_ibm %s [%zu/%zu]: float %08x -> %08x, expected %08x\n", kernel, what, i,
+                        values.size(), std::bit_cast<uint32_t>(values[i]), actual, expected);
+        }
+    }
+}
+
+std::vector<float> from_bits(const std::vector<uint32_t>& bits) {
+    std::vector<float> values(bits.size());
+    for (size_t i = 0; i < bits.size(); ++i) values[i] = std::bit_cast<float>(bits[i]);
+    return values;
+}
+
+void run(const char* kernel) {
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<uint32_t> any_word;
+
+    // Случайные слова: все знаки, экспоненты и мантиссы
+    std::vector<uint32_t> words(1 << 16);
+    for (auto& w : words) w = any_word(rng);
+    check_ibm_to_float(kernel, "random", words);
+
+    // Нули, ненормализованные мантиссы, результаты ниже нормализованного float и переполнение
+    std::vector<uint32_t> ibm_edges = {0x00000000u, 0x80000000u, 0x41000000u, 0x00000001u, 0x80000001u,
+                                       0x00FFFFFFu, 0x7FFFFFFFu, 0xFFFFFFFFu, 0x60FFFFFFu, 0x61100000u,
+                                       0x21000001u, 0x22FFFFFFu, 0x1F800000u, 0x20100000u, 0x42000001u};
+    for (uint32_t e = 0; e < 128; ++e) {
+        for (uint32_t f : {0x000001u, 0x0FFFFFu, 0x100000u, 0x800000u, 0xFFFFFFu}) {
+            ibm_edges.push_back((e << 24) | f);
+            ibm_edges.push_back(0x80000000u | (e << 24) | f);
+        }
+    }
+    check_ibm_to_float(kernel, "edges", ibm_edges);
+
+    // Случайные битовые образы float, включая денормализованные, Inf и NaN
+    std::vector<uint32_t> float_bits(1 << 16);
+    for (auto& b : float_bits) b = any_word(rng);
+    check_float_to_ibm(kernel, "random", from_bits(float_bits));
+
+    const float inf = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<float> float_edges = {0.0f, -0.0f, 1.0f, -1.0f, 0.0625f, 15.999999f, 16.0f,
+                                      std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                                      std::numeric_limits<float>::min(), std::numeric_limits<float>::denorm_min(),
+                                      -std::numeric_limits<float>::denorm_min(), inf, -inf, nan, -nan};
+    for (uint32_t m : {0x000001u, 0x000FFFu, 0x400000u, 0x7FFFFFu}) {
+        float_edges.push_back(std::bit_cast<float>(m));
+        float_edges.push_back(std::bit_cast<float>(0x80000000u | m));
+    }
+    check_float_to_ibm(kernel, "edges", float_edges);
+
+    // Все длины хвоста 0..15 при разном выравнивании; Inf/NaN в хвосте
+    for (size_t n = 0; n < 16; ++n) {
+        for (size_t shift = 0; shift < 4; ++shift) {
+            std::vector<uint32_t> tail_words(words.begin() + shift, words.begin() + shift + n);
+            check_ibm_to_float(kernel, "tail", tail_words);
+            std::vector<float> tail(n);
+            for (size_t i = 0; i < n; ++i) tail[i] = static_cast<float>(i + 1) * (shift % 2 ? -1.5f : 1.5f);
+            check_float_to_ibm(kernel, "tail", tail);
+            if (n > 0) {
+                tail.back() = shift % 2 ? -inf : inf;
+                check_float_to_ibm(kernel, "tail inf", tail);
+                tail.back() = nan;
+                check_float_to_ibm(kernel, "tail nan", tail);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    int kernels = 0;
+    for (const char* kernel : {"scalar", "sse4.1", "avx2", "avx512"}) {
+        if (!set_sample_convert_kernel(kernel)) {
+            std::printf("%s: not supported, skipped\n", kernel);
+            continue;
+        }
+        const int before = failures;
+        run(kernel);
+        ++kernels;
+        std::printf("%s: %s\n", kernel, failures == before ? "ok" : "FAILED");
+    }
+    if (kernels == 0) {
+        std::printf("No sample conversion kernel could be selected\n");
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}